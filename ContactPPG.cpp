@@ -0,0 +1,318 @@
+#include "ContactPPG.hpp"
+#include "opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+ContactPPG::ContactPPG(QObject *parent)
+    : QObject(parent)
+    , trace(CONTACT_MAX_SAMPLES, 1)
+{
+}
+
+void ContactPPG::reset()
+{
+    // Presence is detected again from the next frame
+    if (fingerPresent) {
+        fingerPresent = false;
+        emit fingerPresenceChanged(false);
+    }
+    intensities.clear();
+    lastTime = -1;
+    baseline.clear();
+    smoothed.clear();
+    pulse.clear();
+    pulseHigh = false;
+    intervals.clear();
+    intervalSum = 0.0;
+    lastPeakTime = -1;
+    lastCheckTime = -1;
+    spectrumBpm = 0.0;
+    spectrumTolerance = 0.0;
+    lastValidBpm = 0.0;
+    bpmKalman.reset();
+    previousEma = 0.0;
+    spo2.reset();
+    smoothing.clear();
+    smoothingSum = 0.0;
+    waveform.clear();
+}
+
+double ContactPPG::processFrame(Mat &frameRGB, int64_t timestamp)
+{
+    if (frameRGB.empty()) {
+        return lastValidBpm;
+    }
+
+    // A repeated time adds no sample, and a clock that goes backwards means a new stream
+    const bool repeated = timestamp == lastTime;
+    if (lastTime >= 0 && timestamp < lastTime) {
+        reset();
+    }
+    lastTime = timestamp;
+
+    centerX = frameRGB.cols / 2;
+    centerY = frameRGB.rows / 2;
+    roiSize = std::min(frameRGB.cols, frameRGB.rows) / 3;
+
+    // Nothing to measure without a finger on the lens
+    if (!detectFinger(frameRGB)) {
+        return 0.0;
+    }
+
+    // A repeated frame is still drawn, but measured only once
+    double heartRate = lastValidBpm;
+    if (!repeated) {
+        // R, G and B means over the fingertip disc in one pass
+        Scalar means = discMean(frameRGB, Point(centerX, centerY), roiSize);
+        spo2.update(means);
+
+        // Pulse is taken from channel 2
+        heartRate = calculateHeartRate(means[2], timestamp);
+
+        appendWaveform(timestamp, means[2]);
+    }
+
+    if (guiMode) {
+        draw(frameRGB);
+    }
+
+    return heartRate;
+}
+
+bool ContactPPG::detectFinger(const Mat &frameRGB)
+{
+    // A lit fingertip turns the centre red and saturated; sample a sparse grid of the central square
+    const int half = roiSize / 2;
+    const int x0 = std::max(centerX - half, 0), x1 = std::min(centerX + half, frameRGB.cols - 1);
+    const int y0 = std::max(centerY - half, 0), y1 = std::min(centerY + half, frameRGB.rows - 1);
+
+    int total = 0, red = 0;
+    for (int y = y0; y <= y1; y += FINGER_SAMPLE_STEP) {
+        const uchar *row = frameRGB.ptr<uchar>(y);
+        for (int x = x0; x <= x1; x += FINGER_SAMPLE_STEP) {
+            const uchar *p = row + 3 * x;
+            int r = p[0], g = p[1], b = p[2];
+            int mx = std::max(r, std::max(g, b));
+            int mn = std::min(r, std::min(g, b));
+            if (r == mx && r >= FINGER_MIN_RED && mx - mn >= FINGER_MIN_SATURATION * mx) {
+                red++;
+            }
+            total++;
+        }
+    }
+
+    double score = total > 0 ? (double)red / total : 0.0;
+
+    // Hysteresis between entering and leaving
+    bool present = fingerPresent ? score >= FINGER_LEAVE_SCORE : score >= FINGER_ENTER_SCORE;
+    if (present != fingerPresent) {
+        // Each contact starts from empty windows; reset() reports a lost finger itself
+        reset();
+        if (present) {
+            fingerPresent = true;
+            emit fingerPresenceChanged(true);
+        }
+        emit sendInfo(present ? "Finger detected, hold still" : "Place your finger over the camera and flash");
+    }
+
+    return present;
+}
+
+double ContactPPG::getFilteredBpm(double newBpm)
+{
+    double kalmanFilteredBpm = bpmKalman.update(newBpm);
+
+    // Second level of filtering using EMA
+    double alpha = 0.1; // Smoothing factor (0 < alpha <= 1)
+    double emaFilteredBpm = (alpha * kalmanFilteredBpm) + ((1 - alpha) * previousEma);
+
+    // Update the previous EMA value
+    previousEma = emaFilteredBpm;
+
+    return emaFilteredBpm;
+}
+
+double ContactPPG::calculateHeartRate(double intensity, int64_t timestamp)
+{
+    // Keep the last CONTACT_WINDOW_SIZE seconds
+    const int64_t windowStart = timestamp - (int64_t)(CONTACT_WINDOW_SIZE * 1000);
+    intensities.push(timestamp, intensity);
+    intensities.evictBefore(windowStart);
+    while (!intervals.empty() && intervals.front().time < windowStart) {
+        intervalSum -= intervals.front().length;
+        intervals.pop_front();
+    }
+
+    // A new peak closes an interval, unless it follows a gap
+    if (detectPeak(intensity, timestamp)) {
+        const double interval = timestamp - lastPeakTime;
+        if (lastPeakTime >= 0 && interval >= 60000.0 / CONTACT_MAX_BPM && interval <= 60000.0 / CONTACT_MIN_BPM) {
+            intervals.push_back({timestamp, interval});
+            intervalSum += interval;
+        }
+        lastPeakTime = timestamp;
+    }
+
+    // Wait until the window is filled
+    const int n = intensities.size();
+    if (n < 3 || timestamp - intensities.time(0) < CONTACT_WINDOW_SIZE * 1000 * 0.9) {
+        return lastValidBpm;
+    }
+
+    // The spectrum only confirms the peak rate, so it runs once per interval and unpadded
+    if (lastCheckTime < 0 || timestamp - lastCheckTime >= CONTACT_CROSSCHECK_INTERVAL) {
+        lastCheckTime = timestamp;
+        spectrumBpm = estimateSpectrum();
+    }
+
+    // Mean of the intervals in the window, kept only while the spectrum agrees
+    if (intervals.empty() || spectrumBpm <= 0) {
+        return lastValidBpm;
+    }
+    double bpm = 60000.0 / (intervalSum / intervals.size());
+    if (bpm >= CONTACT_MIN_BPM && bpm <= CONTACT_MAX_BPM && fabs(bpm - spectrumBpm) <= spectrumTolerance) {
+        lastValidBpm = getFilteredBpm(bpm);
+    }
+
+    return lastValidBpm;
+}
+
+bool ContactPPG::detectPeak(double intensity, int64_t timestamp)
+{
+    // Short moving mean against a longer one: noise and slow drift both drop out
+    baseline.push(timestamp, intensity);
+    baseline.evictBefore(timestamp - (int64_t)(CONTACT_BASELINE_SIZE * 1000));
+    smoothed.push(timestamp, intensity);
+    smoothed.evictBefore(timestamp - (int64_t)(CONTACT_PEAK_SMOOTHING * 1000));
+    const double value = smoothed.mean() - baseline.mean();
+    pulse.push(timestamp, value);
+    pulse.evictBefore(timestamp - (int64_t)(CONTACT_BASELINE_SIZE * 1000));
+
+    // A beat is the pulse rising through the upper threshold, and it re-arms below the lower one
+    const double threshold = CONTACT_THRESHOLD * (pulse.max() - pulse.min());
+    if (!pulseHigh && value > threshold) {
+        pulseHigh = true;
+        return true;
+    }
+    if (pulseHigh && value < -threshold) {
+        pulseHigh = false;
+    }
+    return false;
+}
+
+double ContactPPG::estimateSpectrum()
+{
+    // A flat window has no pulse, and normalising it would divide by zero
+    const int n = intensities.size();
+    if (intensities.max() <= intensities.min()) {
+        return 0.0;
+    }
+
+    // Same chain as the face signal: normalise, detrend, strongest frequency in the band
+    const double fps = (n - 1) * 1000.0 / (intensities.time(n - 1) - intensities.time(0));
+    Mat1d signal = trace.rowRange(0, n);
+    for (int i = 0; i < n; i++) {
+        signal(i) = intensities.value(i);
+    }
+    normalization(signal, signal);
+    // The smoothness priors filter cuts off near 12 * fps / sqrt(lambda) BPM, so lambda
+    // grows with the square of the frame rate to keep the cutoff below the pulse band
+    const double lambda = 12.0 * fps / CONTACT_DETREND_CUTOFF;
+    detrend(signal, signal, (int)(lambda * lambda));
+
+    // Without zero padding the bins are 60 / CONTACT_WINDOW_SIZE BPM apart, fine enough
+    // to catch a doubled or halved peak rate, and the peak bin's neighbours hold the
+    // whole mainlobe for the quality gate
+    double quality = -100.0;
+    double bpm = dominantFrequency(signal, fps, CONTACT_MIN_BPM, CONTACT_MAX_BPM, 0, &quality);
+    if (quality < CONTACT_MIN_QUALITY) {
+        return 0.0;
+    }
+    spectrumTolerance = CONTACT_CROSSCHECK_BINS * fps * 60.0 / n;
+    return bpm;
+}
+
+void ContactPPG::appendWaveform(int64_t timestamp, double value)
+{
+    if (smoothing.full()) {
+        smoothingSum -= smoothing.front();
+    }
+    smoothing.push_back(value);
+    smoothingSum += value;
+
+    // The smoothed value belongs to the centre of the window, CONTACT_SMOOTHING_WINDOW samples back
+    if (smoothing.full()) {
+        waveform.push(timestamp, smoothingSum / smoothing.size());
+    }
+}
+
+void ContactPPG::updateGrid(const Size &frameSize)
+{
+    gridFrameSize = frameSize;
+    grid.clear();
+
+    int lineY = centerY;
+    int startX = centerX - roiSize;
+    int endX = centerX + roiSize;
+    int step = std::max(roiSize / 10, 1);
+
+    for (int y = lineY - roiSize/3; y <= lineY + roiSize/3; y += step) {
+        grid.push_back({Point(startX, y), Point(endX, y)});
+    }
+    for (int x = startX; x <= endX; x += step) {
+        grid.push_back({Point(x, lineY - roiSize/3), Point(x, lineY + roiSize/3)});
+    }
+    waveformPoints.reserve(CONTACT_PULSE_BUFFER_SIZE);
+}
+
+void ContactPPG::draw(Mat &frameRGB)
+{
+    if (frameRGB.size() != gridFrameSize) {
+        updateGrid(frameRGB.size());
+    }
+
+    int lineY = centerY;
+    int startX = centerX - roiSize;
+    int endX = centerX + roiSize;
+
+    // Grid and reference line
+    polylines(frameRGB, grid, false, Scalar(50, 50, 50), 1);
+    line(frameRGB, Point(startX, lineY), Point(endX, lineY), Scalar(100, 100, 100), 2);
+
+    // Waveform: the samples are already smoothed, only scaling to the current range is left
+    const int n = waveform.size();
+    if (n > 1) {
+        double minVal = waveform.min();
+        double range = waveform.max() - minVal;
+        if (range <= 0) {
+            range = 1.0;
+        }
+        double dx = (double)(endX - startX) / (CONTACT_PULSE_BUFFER_SIZE - 1);
+        double dy = (roiSize / 3) / range;
+
+        waveformPoints.resize(n);
+        for (int i = 0; i < n; i++) {
+            waveformPoints[i] = Point(startX + cvRound(i * dx), lineY - cvRound((waveform.value(i) - minVal) * dy));
+        }
+        polylines(frameRGB, waveformPoints, false, Scalar(0, 255, 255), 2, LINE_AA);
+    }
+
+    cv::circle(frameRGB, Point(centerX, centerY), roiSize, Scalar(0, 255, 255), 2);
+
+    // BPM text, measured only when the shown value changes
+    int fontFace = FONT_HERSHEY_DUPLEX;
+    double fontScale = 1.5;
+    int thickness = 2;
+    int bpm = static_cast<int>(std::round(lastValidBpm));
+    if (bpm != shownBpm) {
+        shownBpm = bpm;
+        bpmText = std::to_string(bpm) + " BPM";
+        int baseline = 0;
+        bpmTextSize = getTextSize(bpmText, fontFace, fontScale, thickness, &baseline);
+    }
+    Point textOrg(centerX - bpmTextSize.width / 2, centerY - roiSize/2);
+
+    putText(frameRGB, bpmText, textOrg, fontFace, fontScale, Scalar(0, 0, 0), thickness + 1);
+    putText(frameRGB, bpmText, textOrg, fontFace, fontScale, Scalar(255, 255, 255), thickness);
+}
@@ -0,0 +1,209 @@
+#ifndef ContactPPG_hpp
+#define ContactPPG_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <QObject>
+#include <opencv2/opencv.hpp>
+#include "slidingwindow.h"
+
+#define CONTACT_WINDOW_SIZE 6.0 // seconds of peak intervals averaged, and of intensity in the cross-check
+#define CONTACT_MIN_BPM 40
+#define CONTACT_MAX_BPM 200
+#define CONTACT_BASELINE_SIZE 1.0 // seconds, moving mean removed before peak detection
+#define CONTACT_PEAK_SMOOTHING 0.07 // seconds averaged to suppress sensor noise
+#define CONTACT_THRESHOLD 0.15 // hysteresis, fraction of the pulse range
+#define CONTACT_MAX_PEAKS 32
+#define CONTACT_CROSSCHECK_INTERVAL 1000 // ms between spectral cross-checks
+#define CONTACT_CROSSCHECK_BINS 1.0 // spectrum bins the peak rate may differ by
+#define CONTACT_MIN_QUALITY 0.0 // dB, below this the cross-check rejects every reading
+#define CONTACT_DETREND_CUTOFF 20 // BPM, trends slower than this are removed
+#define CONTACT_PULSE_BUFFER_SIZE 200
+#define CONTACT_SMOOTHING_WINDOW 5 // samples on each side
+#define CONTACT_MAX_SAMPLES 1024 // window capacity, enough for CONTACT_WINDOW_SIZE at 170 fps
+#define FINGER_SAMPLE_STEP 8 // pixel stride in the presence patch
+#define FINGER_MIN_RED 80
+#define FINGER_MIN_SATURATION 0.4
+#define FINGER_ENTER_SCORE 0.8 // fraction of red, saturated samples to detect a finger
+#define FINGER_LEAVE_SCORE 0.6 // and to lose it again
+
+class BPMKalmanFilter {
+private:
+    cv::KalmanFilter kf;
+    bool initialized;
+
+public:
+    BPMKalmanFilter() : kf(2, 1, 0) {  // 2 state variables (value and velocity), 1 measurement
+        initialized = false;
+
+        // Initialize transition matrix (state update matrix)
+        kf.transitionMatrix = (cv::Mat_<float>(2, 2) <<
+                                   1, 1,   // Position update: x(t) = x(t-1) + v(t-1)
+                               0, 1    // Velocity update: v(t) = v(t-1)
+                               );
+
+        // Measurement matrix (what we can measure)
+        kf.measurementMatrix = (cv::Mat_<float>(1, 2) << 1, 0);  // We only measure position
+
+        // Increase filtering effect
+        setIdentity(kf.processNoiseCov, cv::Scalar::all(0.0001));  // Lower process noise for smoother predictions
+        setIdentity(kf.measurementNoiseCov, cv::Scalar::all(0.5));  // Higher measurement noise to trust predictions more
+
+        // Initial state covariance matrix
+        setIdentity(kf.errorCovPost, cv::Scalar::all(1));
+    }
+
+    void reset() {
+        initialized = false;
+        setIdentity(kf.errorCovPost, cv::Scalar::all(1));
+    }
+
+    float update(float measurement) {
+        if (!initialized) {
+            kf.statePost.at<float>(0) = measurement;
+            kf.statePost.at<float>(1) = 0;
+            initialized = true;
+            return measurement;
+        }
+
+        cv::Mat prediction = kf.predict();
+
+        cv::Mat_<float> measurement_matrix(1, 1);
+        measurement_matrix(0) = measurement;
+
+        cv::Mat estimated = kf.correct(measurement_matrix);
+
+        return estimated.at<float>(0);
+    }
+};
+
+// Streaming AC/DC tracker per colour channel with a ratio-of-ratios SpO2 estimate
+class SpO2Estimator {
+private:
+    static constexpr double DC_ALPHA = 0.02;   // ~1.5 s at 30 fps
+    static constexpr double AC_ALPHA = 0.05;
+    static constexpr int WARMUP = 90;
+
+    double dc[3] = {0, 0, 0};
+    double ac2[3] = {0, 0, 0};
+    int samples = 0;
+
+public:
+    void reset() {
+        for (int c = 0; c < 3; c++) {
+            dc[c] = 0;
+            ac2[c] = 0;
+        }
+        samples = 0;
+    }
+
+    void update(const cv::Scalar &means) {
+        for (int c = 0; c < 3; c++) {
+            if (samples == 0) {
+                dc[c] = means[c];
+                continue;
+            }
+            dc[c] += DC_ALPHA * (means[c] - dc[c]);
+            double ac = means[c] - dc[c];
+            ac2[c] += AC_ALPHA * (ac * ac - ac2[c]);
+        }
+        samples++;
+    }
+
+    // Empirical calibration SpO2 = 110 - 25 R on red over blue; 0 until warmed up
+    double estimate() const {
+        if (samples < WARMUP || dc[0] <= 0 || dc[2] <= 0 || ac2[2] <= 0) {
+            return 0.0;
+        }
+        double r = (std::sqrt(ac2[0]) / dc[0]) / (std::sqrt(ac2[2]) / dc[2]);
+        return std::clamp(110.0 - 25.0 * r, 0.0, 100.0);
+    }
+};
+
+// Fingertip (contact) PPG: frame in, BPM out, driven by frame timestamps
+class ContactPPG : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ContactPPG(QObject *parent = nullptr);
+    // timestamp in milliseconds of the frame clock
+    double processFrame(cv::Mat &frameRGB, int64_t timestamp);
+    double getSpO2() const { return spo2.estimate(); }
+    bool isFingerPresent() const { return fingerPresent; }
+    void setGuiMode(bool enabled) { guiMode = enabled; }
+    void reset();
+
+private:
+    bool detectFinger(const cv::Mat &frameRGB);
+    double calculateHeartRate(double intensity, int64_t timestamp);
+    // True when intensity completes the rising edge of a new beat
+    bool detectPeak(double intensity, int64_t timestamp);
+    // BPM of the intensity window through the shared DSP chain, 0 when the window fails the quality gate
+    double estimateSpectrum();
+    double getFilteredBpm(double newBpm);
+    void appendWaveform(int64_t timestamp, double value);
+    void updateGrid(const cv::Size &frameSize);
+    void draw(cv::Mat &frameRGB);
+
+    // Settings
+    bool guiMode = true;
+
+    // Fingertip disc
+    int centerX = 0;
+    int centerY = 0;
+    int roiSize = 0;
+
+    // Finger presence
+    bool fingerPresent = false;
+
+    // Intensity window
+    SlidingWindow<CONTACT_MAX_SAMPLES> intensities;
+    int64_t lastTime = -1;
+
+    // Peak detection: smoothed intensity minus its baseline, with hysteresis
+    SlidingWindow<CONTACT_MAX_SAMPLES> baseline;
+    SlidingWindow<CONTACT_MAX_SAMPLES> smoothed;
+    SlidingWindow<CONTACT_MAX_SAMPLES> pulse;
+    bool pulseHigh = false;
+
+    // Peak intervals ending inside the window
+    struct Interval {
+        int64_t time;
+        double length;
+    };
+    RingBuffer<Interval, CONTACT_MAX_PEAKS> intervals;
+    double intervalSum = 0.0;
+    int64_t lastPeakTime = -1;
+
+    // Cross-check: the window is copied into trace for the shared filters once per interval
+    cv::Mat1d trace;
+    int64_t lastCheckTime = -1;
+    double spectrumBpm = 0.0;
+    double spectrumTolerance = 0.0;
+
+    // Estimation
+    double lastValidBpm = 0.0;
+    BPMKalmanFilter bpmKalman;
+    double previousEma = 0.0;
+    SpO2Estimator spo2;
+
+    // Display: centred moving average applied once per incoming sample
+    RingBuffer<double, 2 * CONTACT_SMOOTHING_WINDOW + 1> smoothing;
+    double smoothingSum = 0.0;
+    SlidingWindow<CONTACT_PULSE_BUFFER_SIZE> waveform;
+    std::vector<cv::Point> waveformPoints;
+    std::vector<std::vector<cv::Point>> grid;
+    cv::Size gridFrameSize;
+    int shownBpm = -1;
+    std::string bpmText;
+    cv::Size bpmTextSize;
+
+signals:
+    void sendInfo(QString);
+    void fingerPresenceChanged(bool);
+};
+
+#endif /* ContactPPG_hpp */
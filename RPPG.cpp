@@ -1,6 +1,9 @@
 #include "RPPG.hpp"
+#include "eventlog.h"
 #include "opencv.hpp"
+#include "profiler.h"
 #include <future>
+#include <QResource>
 
 using namespace cv;
 using namespace dnn;
@@ -15,12 +18,32 @@ using namespace std;
 #define QUALITY_LEVEL 0.01
 #define MIN_DISTANCE 20
 
+// Contents of a Qt resource. Uncompressed resources are returned without a copy.
+static QByteArray resourceData(const string &path) {
+    QResource resource(QString::fromStdString(path));
+    if (!resource.isValid()) {
+        return QByteArray();
+    }
+    return resource.uncompressedData();
+}
+
+// Motion of a box relative to its size: centre displacement plus scale change
+static double boxMotion(const Rect &from, const Rect &to) {
+    if (from.width <= 0 || from.height <= 0) {
+        return 0.0;
+    }
+    Point2f d = (Point2f(to.tl()) + Point2f(to.br())) * 0.5 - (Point2f(from.tl()) + Point2f(from.br())) * 0.5;
+    return norm(d) / from.width + fabs((double)to.width / from.width - 1.0);
+}
+
 RPPG::RPPG(QObject* parent)
     :QObject(parent)
+    , beatFilter(LOW_BPM / SEC_PER_MIN, HIGH_BPM / SEC_PER_MIN)
+    , beatDetector(SEC_PER_MIN * 1000.0 / HIGH_BPM, SEC_PER_MIN * 1000.0 / LOW_BPM)
 {
 }
 
-bool RPPG::load(int camIndex, const string &haarPath, const string &dnnProtoPath, const string &dnnModelPath) {
+bool RPPG::load(const string &haarPath, const string &dnnProtoPath, const string &dnnModelPath) {
 
     // algorithm setting
     rPPGAlgorithm rPPGAlg;
@@ -46,127 +69,117 @@ bool RPPG::load(int camIndex, const string &haarPath, const string &dnnProtoPath
     int minSignalSize;
     minSignalSize = DEFAULT_MIN_SIGNAL_SIZE;
 
+    // respiration window settings
+    int respSignalSize;
+    respSignalSize = DEFAULT_RESP_SIGNAL_SIZE;
+    int respMinSignalSize;
+    respMinSignalSize = DEFAULT_RESP_MIN_SIGNAL_SIZE;
+
+    // early signal size setting
+    int earlySignalSize;
+    earlySignalSize = DEFAULT_EARLY_SIGNAL_SIZE;
+
     // Reading downsample setting
     int downsample;
     downsample = DEFAULT_DOWNSAMPLE;
-    QString _haarPath, _dnnProtoPath, _dnnModelPath;
-
-#if defined(Q_OS_IOS) || defined(Q_OS_ANDROID)
-    _haarPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + haarPath.c_str();
-    std::ifstream test1(_haarPath.toStdString().c_str());
-    if (!test1.is_open()) {
-        std::cout << "Face classifier xml not found!" << std::endl;
-        info = "Face classifier xml not found!";
-        emit sendInfo(info);
-        return false;
-    }
-
-    _dnnProtoPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + dnnProtoPath.c_str();
-    std::ifstream test2(_dnnProtoPath.toStdString().c_str());
-    if (!test2.is_open()) {
-        std::cout << "DNN proto file not found!" << std::endl;
-        info = "DNN proto file not found!";
-        emit sendInfo(info);
-        return false;
-    }
-
-    _dnnModelPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + dnnModelPath.c_str();
-    std::ifstream test3(_dnnModelPath.toStdString().c_str());
-    if (!test3.is_open()) {
-        std::cout << "DNN model file not found!" << std::endl;
-        info = "DNN model file not found!";
-        emit sendInfo(info);
-        return false;
-    }    
-#else
-    std::ifstream test1(HAAR_CLASSIFIER_PATH);
-    if (!test1) {
-        std::cout << "Face classifier xml not found!" << std::endl;
-        info = "Face classifier xml not found!";
-        emit sendInfo(info);
-        return false;
-    }
-
-    std::ifstream test2(DNN_PROTO_PATH);
-    if (!test2) {
-        std::cout << "DNN proto file not found!" << std::endl;
-        info = "DNN proto file not found!";
-        emit sendInfo(info);
-        return false;
-    }
-
-    std::ifstream test3(DNN_MODEL_PATH);
-    if (!test3) {
-        std::cout << "DNN model file not found!" << std::endl;
-        info = "DNN model file not found!";
-        emit sendInfo(info);
-        return false;
-    }
-
-    _haarPath = haarPath.c_str();
-    _dnnProtoPath = dnnProtoPath.c_str();
-    _dnnModelPath = dnnModelPath.c_str();
-
-#endif    
-
-    bool offlineMode = false;
-    int width = 0;
-    int height = 0;
-    double timeBase = 0.0;
-    VideoCapture localCap;
-
-    //    std::future<void> asyncInitialization = std::async(std::launch::async, [&]() {
-    //    });
-
-    //    asyncInitialization.wait();
-
-    try {
-        localCap.open(camIndex);
-    } catch (cv::Exception& e) {
-        std::cerr << "OpenCV Exception: " << e.what() << std::endl;
-        std::cerr << "Could not open camera with index: " << camIndex << std::endl;
-    }
-
-    if (!localCap.isOpened()) {
-        width = 480;
-        height = 800;
-        timeBase = 0.001;
-    } else {
-        // Load video information
-        width = localCap.get(cv::CAP_PROP_FRAME_WIDTH);
-        height = localCap.get(cv::CAP_PROP_FRAME_HEIGHT);
-        timeBase = 0.001;
-
-        if (localCap.isOpened())
-            localCap.release();
-    }
 
-    std::string title = offlineMode ? "rPPG offline" : "rPPG online";
+    // Time stamps are in milliseconds
+    double timeBase = 0.001;
 
     this->rPPGAlg = rPPGAlg;
     this->faceDetAlg = faceDetAlg;
     this->guiMode = true;
     this->lastSamplingTime = 0;
-    this->minFaceSize = Size(min(width, height) * REL_MIN_FACE_SIZE, min(width, height) * REL_MIN_FACE_SIZE);
+    // Resolution dependent settings follow the first frame, see updateFrameSize
+    this->frameSize = Size();
     this->maxSignalSize = maxSignalSize;
     this->minSignalSize = minSignalSize;
+    this->earlySignalSize = earlySignalSize;
+    this->respSignalSize = respSignalSize;
+    this->respMinSignalSize = respMinSignalSize;
     this->rescanFlag = false;
     this->rescanFrequency = rescanFrequency;
     this->samplingFrequency = samplingFrequency;
     this->timeBase = timeBase;
-#if defined(Q_OS_IOS)
-    this->time_correction = 10;
-#endif
 
-    // Load classifier
-    switch (faceDetAlg) {
-    case haar:
-        haarClassifier.load(_haarPath.toStdString());
+    // Model resources, read on demand
+    this->haarPath = haarPath;
+    this->dnnProtoPath = dnnProtoPath;
+    this->dnnModelPath = dnnModelPath;
+
+    // Only the selected detector is loaded now, in the background
+    startLoading(faceDetAlg);
+
+    return true;
+}
+
+void RPPG::setFaceDetAlgorithm(faceDetAlgorithm alg) {
+    faceDetAlg = alg;
+    startLoading(alg);
+    invalidateFace();
+}
+
+void RPPG::startLoading(faceDetAlgorithm alg) {
+    if (detectorLoaded[alg] || detectorLoading[alg].valid()) {
+        return;
+    }
+    // No model given, e.g. for replay
+    if ((alg == haar ? haarPath : dnnModelPath).empty()) {
+        return;
+    }
+    loadStart[alg] = getTickCount();
+    detectorLoading[alg] = async(launch::async, [this, alg]() { return readDetector(alg); });
+}
+
+bool RPPG::detectorReady() {
+    if (detectorLoaded[faceDetAlg]) {
+        return true;
+    }
+    future<bool> &loading = detectorLoading[faceDetAlg];
+    if (!loading.valid() || loading.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return false;
+    }
+    detectorLoaded[faceDetAlg] = loading.get();
+    if (detectorLoaded[faceDetAlg]) {
+        qDebug() << "Face detector ready after"
+                 << (getTickCount() - loadStart[faceDetAlg]) * 1000.0 / getTickFrequency() << "ms";
+    }
+    return detectorLoaded[faceDetAlg];
+}
+
+// Runs on a loader thread. The classifier members are not used until the future is collected.
+bool RPPG::readDetector(faceDetAlgorithm alg) {
+
+    // Load classifier straight from the resource data, no files involved
+    switch (alg) {
+    case haar: {
+        QByteArray haar = resourceData(haarPath);
+        if (haar.isEmpty()) {
+            emit sendInfo("Face classifier xml not found!");
+            return false;
+        }
+        FileStorage fs(string(haar.constData(), haar.size()), FileStorage::READ | FileStorage::MEMORY);
+        if (!fs.isOpened() || !haarClassifier.read(fs.getFirstTopLevelNode())) {
+            emit sendInfo("Face classifier xml could not be read!");
+            return false;
+        }
         break;
-    case deep:
-        dnnClassifier = readNetFromCaffe(_dnnProtoPath.toStdString(), _dnnModelPath.toStdString());
+    }
+    case deep: {
+        QByteArray proto = resourceData(dnnProtoPath);
+        if (proto.isEmpty()) {
+            emit sendInfo("DNN proto file not found!");
+            return false;
+        }
+        QByteArray model = resourceData(dnnModelPath);
+        if (model.isEmpty()) {
+            emit sendInfo("DNN model file not found!");
+            return false;
+        }
+        dnnClassifier = readNetFromCaffe(proto.constData(), proto.size(), model.constData(), model.size());
         break;
     }
+    }
 
     return true;
 }
@@ -174,20 +187,45 @@ bool RPPG::load(int camIndex, const string &haarPath, const string &dnnProtoPath
 void RPPG::exit() {   
 }
 
-double RPPG::processFrame(Mat &frameRGB, Mat &frameGray) {
+double RPPG::processFrame(Mat &frameRGB, Mat &frameGray, int64_t timestamp) {
+
+    TRACE_SCOPE("rppg");
+
+    // The previous frame was at timeOrigin + process_time. A repeated time adds no sample
+    // and would make the frame rate infinite; a clock that goes backwards means a new stream.
+    if (timeOrigin >= 0 && timestamp == timeOrigin + process_time) {
+        return meanBpm;
+    }
+    if (timeOrigin >= 0 && timestamp < timeOrigin + process_time) {
+        reset();
+    }
+
+    // Times are kept relative to the first frame so they fit the int sample buffer
+    if (timeOrigin < 0) {
+        timeOrigin = timestamp;
+    }
+    process_time = (int)(timestamp - timeOrigin);
+    motion = 0.0;
 
-    process_time = get_current_time();
+    if (frameRGB.size() != frameSize) {
+        updateFrameSize(frameRGB.size());
+    }
+
+    // Video keeps flowing while the detector model loads; detection starts once it is ready
+    bool canDetect = !injectedBox.empty() || detectorReady();
 
     if (!faceValid)
     {
-        lastScanTime = process_time;
-        detectFace(frameRGB, frameGray);
-
+        if (canDetect) {
+            lastScanTime = process_time;
+            detectFace(frameRGB, frameGray);
+        }
     }
-    else if ((process_time - lastScanTime) * timeBase * time_correction >= 1/rescanFrequency) {
+    else if (canDetect && (process_time - lastScanTime) * timeBase >= 1/rescanFrequency) {
         lastScanTime = process_time;
         detectFace(frameRGB, frameGray);
         rescanFlag = true;
+        Profiler::instance().count(Counter::Rescans);
     }
     else
     {
@@ -196,119 +234,244 @@ double RPPG::processFrame(Mat &frameRGB, Mat &frameGray) {
 
     if (faceValid)
     {
+        // New values
+        Scalar means;
+        {
+            PROFILE_STAGE(Stage::Mean);
+            means = mean(frameRGB, mask);
+        }
+
+        RoiSample sample;
+        sample.time = process_time;
+        for (int c = 0; c < 3; c++) {
+            sample.means[c] = means(c);
+        }
+        sample.rescan = rescanFlag;
+        sample.reset = s.empty();
+        sample.motion = motion;
+        sample.box = box;
+
+        addSample(sample);
+        estimate();
+        detectBeat(sample.means[1], sample.time, sample.rescan || sample.motion > MOTION_JUMP_THRESHOLD);
+
+        if (guiMode) {
+            updateOverlay();
+        }
+    }
+    else
+    {
+        clearOverlay();
+    }
+
+    rescanFlag = false;
+    frameGray.copyTo(lastFrameGray);
+    return meanBpm;
+}
+
+void RPPG::addSample(const RoiSample &sample) {
+
+    {
+        PROFILE_STAGE(Stage::Buffer);
+
         // Update fps
         fps = getFps(t, timeBase);
 
         // Remove old values from raw signal buffer
-        while (s.rows > fps * maxSignalSize) {
+        while (s.rows > fps * max(maxSignalSize, respSignalSize)) {
             push(s);
             push(t);
             push(re);
+            push(mo);
         }
 
-        assert(s.rows == t.rows && s.rows == re.rows);
+        assert(s.rows == t.rows && s.rows == re.rows && s.rows == mo.rows);
+
+        bool first = s.empty();
+        if (first) {
+            firstSampleTime = sample.time;
+        }
 
-        // New values
-        Scalar means = mean(frameRGB, mask);
         // Add new values to raw signal buffer
-        double values[] = {means(0), means(1), means(2)};
-        s.push_back(Mat(1, 3, CV_64F, values));
+        s.push_back(Mat(1, 3, CV_64F, (void *)sample.means));
+        t.push_back(sample.time);
+
+        // Save rescan flag and motion magnitude
+        re.push_back((uchar)sample.rescan);
+        mo.push_back(sample.motion);
+
+        // Room for the longest window once the row layout is known, so a full buffer whose
+        // length wobbles with the frame rate never grows again
+        if (first) {
+            int capacity = SIGNAL_RESERVE_FPS * max(maxSignalSize, respSignalSize);
+            s.reserve(capacity);
+            t.reserve(capacity);
+            re.reserve(capacity);
+            mo.reserve(capacity);
+        }
+    }
 
-        //        QDateTime currentTime = QDateTime::currentDateTimeUtc();
-        //        qint64 currentTimeInMilliseconds = currentTime.toMSecsSinceEpoch();
-        //        cv::Mat matTime = cv::Mat(1, 1, CV_64F);  // Use CV_64F for long long
-        //        matTime.at<double>(0, 0) = static_cast<double>(currentTimeInMilliseconds);
+    if (recorder) {
+        recorder->append(sample);
+    }
+}
 
-        t.push_back(process_time* time_correction);
+void RPPG::replaySample(const Mat1d &means, const Mat1i &times, const Mat1b &rescans, const Mat1d &motions,
+                        int index, bool reset, bool estimateNow) {
 
-        // Save rescan flag
-        re.push_back(rescanFlag);
+    if (reset) {
+        invalidateFace();
+        replayStart = index;
+    }
 
-        // Update fps
-        fps = getFps(t, timeBase);
+    // Same trimming as addSample, done by moving the start of the window
+    Mat1i previous = times.rowRange(replayStart, index);
+    fps = getFps(previous, timeBase);
+    while (index - replayStart > fps * max(maxSignalSize, respSignalSize)) {
+        replayStart++;
+    }
+    if (index == replayStart) {
+        firstSampleTime = times(index);
+    }
 
-        // Update band spectrum limits
-        low = (int)(s.rows * LOW_BPM / SEC_PER_MIN / fps);
-        high = (int)(s.rows * HIGH_BPM / SEC_PER_MIN / fps) + 1;
-
-        int valid_signal = fps * minSignalSize;      
-
-        // If valid signal is large enough: estimate
-        if (s.rows >= valid_signal) {
-
-            // Filtering
-            switch (rPPGAlg) {
-            case g:
-                extractSignal_g();
-                break;
-            case pca:
-                extractSignal_pca();
-                break;
-            case xminay:
-                extractSignal_xminay();
-                break;
-            }
+    s = means.rowRange(replayStart, index + 1);
+    t = times.rowRange(replayStart, index + 1);
+    re = rescans.rowRange(replayStart, index + 1);
+    mo = motions.rowRange(replayStart, index + 1);
+    process_time = times(index);
+
+    if (estimateNow) {
+        estimate();
+    }
+    detectBeat(means(index, 1), times(index), rescans(index) || motions(index) > MOTION_JUMP_THRESHOLD);
+}
+
+int RPPG::dropReplayRows() {
+    int rows = replayStart;
+    replayStart = 0;
+    return rows;
+}
+
+void RPPG::estimate() {
+
+    // Update fps
+    fps = getFps(t, timeBase);
+
+    // Heart rate works on the newest maxSignalSize seconds of the shared buffer
+    int hrRows = min(s.rows, (int)(fps * maxSignalSize));
+    s_w = s.rowRange(s.rows - hrRows, s.rows);
+
+    // Update band spectrum limits
+    low = (int)(s_w.rows * LOW_BPM / SEC_PER_MIN / fps);
+    high = (int)(s_w.rows * HIGH_BPM / SEC_PER_MIN / fps) + 1;
+
+    int valid_signal = fps * minSignalSize;
+    int early_signal = fps * earlySignalSize;
 
-            // HR estimation
+    // If signal is large enough and the face is steady: estimate, progressively until the full window is available
+    if (s_w.rows >= early_signal && !motionSuppressed()) {
+
+        updateJumps();
+        jumps_w = jumps.rowRange(jumps.rows - hrRows, jumps.rows);
+
+        // Filtering
+        switch (rPPGAlg) {
+        case g:
+            extractSignal_g();
+            break;
+        case pca:
+            extractSignal_pca();
+            break;
+        case xminay:
+            extractSignal_xminay();
+            break;
+        }
+
+        // HR estimation
+        if (s_w.rows >= valid_signal) {
             estimateHeartrate();
+        } else {
+            estimateProgressive();
         }
 
-        if (guiMode) {
-            draw(frameRGB);
+        // Respiration shares the raw buffer but only runs once per sampling period
+        if (s.rows >= fps * respMinSignalSize &&
+            (process_time - lastRespTime) * timeBase >= 1/samplingFrequency) {
+            lastRespTime = process_time;
+            estimateRespiration();
         }
     }
+}
 
-    rescanFlag = false;
-    frameGray.copyTo(lastFrameGray);
-    return meanBpm;
+void RPPG::updateFrameSize(const Size &size) {
+
+    frameSize = size;
+    minFaceSize = Size(min(size.width, size.height) * REL_MIN_FACE_SIZE,
+                       min(size.width, size.height) * REL_MIN_FACE_SIZE);
+
+    // Boxes, corners and the previous frame belong to the old format
+    invalidateFace();
+    corners.clear();
+    lastFrameGray.release();
 }
 
 void RPPG::detectFace(Mat &frameRGB, Mat &frameGray) {
 
+    PROFILE_STAGE(Stage::Detect);
+
     //    cout << "Scanning for faces…" << faceDetAlg << " " << endl;
     vector<Rect> boxes = {};
 
-    switch (faceDetAlg) {
-    case haar:
-        // Detect faces with Haar classifier
-        if (!frameGray.empty()) {
-            haarClassifier.detectMultiScale(frameGray, boxes, 1.1, 2, CASCADE_SCALE_IMAGE, minFaceSize);
-        } else {
-            // Handle the case when frameGray is empty
-            cerr << "Error: Input grayscale frame is empty." << endl;
-        }
-        break;
-    case deep:
-        // Detect faces with DNN
-        Mat resize300;
-        cv::resize(frameRGB, resize300, Size(300, 300));
-        Mat blob = blobFromImage(resize300, 1.0, Size(300, 300), Scalar(104.0, 177.0, 123.0));
-        dnnClassifier.setInput(blob);
-        Mat detection = dnnClassifier.forward();
-        Mat detectionMat(detection.size[2], detection.size[3], CV_32F, detection.ptr<float>());
-        float confidenceThreshold = 0.5;
-
-        for (int i = 0; i < detectionMat.rows; i++) {
-            float confidence = detectionMat.at<float>(i, 2);
-            if (confidence > confidenceThreshold) {
-                int xLeftBottom = static_cast<int>(detectionMat.at<float>(i, 3) * frameRGB.cols);
-                int yLeftBottom = static_cast<int>(detectionMat.at<float>(i, 4) * frameRGB.rows);
-                int xRightTop = static_cast<int>(detectionMat.at<float>(i, 5) * frameRGB.cols);
-                int yRightTop = static_cast<int>(detectionMat.at<float>(i, 6) * frameRGB.rows);
-                Rect object((int)xLeftBottom, (int)yLeftBottom,
-                            (int)(xRightTop - xLeftBottom),
-                            (int)(yRightTop - yLeftBottom));
-                boxes.push_back(object);
+    if (!injectedBox.empty()) {
+        boxes.push_back(injectedBox);
+    }
+    else {
+        switch (faceDetAlg) {
+        case haar:
+            // Detect faces with Haar classifier
+            if (!frameGray.empty()) {
+                haarClassifier.detectMultiScale(frameGray, boxes, 1.1, 2, CASCADE_SCALE_IMAGE, minFaceSize);
+            } else {
+                // Handle the case when frameGray is empty
+                LOG_EVENT(LogEvent::EmptyGrayFrame);
+            }
+            break;
+        case deep:
+            // Detect faces with DNN
+            Mat resize300;
+            cv::resize(frameRGB, resize300, Size(300, 300));
+            Mat blob = blobFromImage(resize300, 1.0, Size(300, 300), Scalar(104.0, 177.0, 123.0));
+            dnnClassifier.setInput(blob);
+            Mat detection = dnnClassifier.forward();
+            Mat detectionMat(detection.size[2], detection.size[3], CV_32F, detection.ptr<float>());
+            float confidenceThreshold = 0.5;
+
+            for (int i = 0; i < detectionMat.rows; i++) {
+                float confidence = detectionMat.at<float>(i, 2);
+                if (confidence > confidenceThreshold) {
+                    int xLeftBottom = static_cast<int>(detectionMat.at<float>(i, 3) * frameRGB.cols);
+                    int yLeftBottom = static_cast<int>(detectionMat.at<float>(i, 4) * frameRGB.rows);
+                    int xRightTop = static_cast<int>(detectionMat.at<float>(i, 5) * frameRGB.cols);
+                    int yRightTop = static_cast<int>(detectionMat.at<float>(i, 6) * frameRGB.rows);
+                    Rect object((int)xLeftBottom, (int)yLeftBottom,
+                                (int)(xRightTop - xLeftBottom),
+                                (int)(yRightTop - yLeftBottom));
+                    boxes.push_back(object);
+                }
             }
+            break;
         }
-        break;
     }
 
     if (boxes.size() > 0) {
 
         //        cout << "Found a face" << endl;
 
+        Rect previousBox = box;
         setNearestBox(boxes);
+        if (faceValid) {
+            motion = boxMotion(previousBox, box);
+        }
         detectCorners(frameGray);
         updateROI();
         updateMask(frameGray);
@@ -365,6 +528,8 @@ void RPPG::detectCorners(Mat &frameGray) {
 
 void RPPG::trackFace(Mat &frameGray) {
 
+    PROFILE_STAGE(Stage::Track);
+
     // Make sure enough corners are available
     if (corners.size() < MIN_CORNERS) {
         detectCorners(frameGray);
@@ -394,7 +559,7 @@ void RPPG::trackFace(Mat &frameGray) {
             corners_0v.push_back(corners_0[j]);
             corners_1v.push_back(corners_1[j]);
         } else {
-            qDebug() << "Mis! ";
+            LOG_EVENT(LogEvent::CornerRejected, (int64_t)j);
         }
     }
 
@@ -408,6 +573,17 @@ void RPPG::trackFace(Mat &frameGray) {
 
         if (transform.total() > 0) {
 
+            // Motion magnitude from the rigid transform: translation of the box centre
+            // relative to its width, rotation in radians and scale change
+            Mat1d m = transform;
+            double a = m(0, 0), b = m(1, 0);
+            Point2f centre = (Point2f(box.tl()) + Point2f(box.br())) * 0.5;
+            Point2f moved(a * centre.x - b * centre.y + m(0, 2), b * centre.x + a * centre.y + m(1, 2));
+            double translation = box.width > 0 ? norm(moved - centre) / box.width : 0.0;
+            double rotation = fabs(atan2(b, a));
+            double scale = fabs(sqrt(a * a + b * b) - 1.0);
+            motion = translation + rotation + scale;
+
             // Update box
             Contour2f boxCoords;
             boxCoords.push_back(box.tl());
@@ -429,7 +605,8 @@ void RPPG::trackFace(Mat &frameGray) {
         }
 
     } else {
-        qDebug() << "Tracking failed! Not enough corners left.";
+        LOG_EVENT(LogEvent::TrackingLost, (int64_t)corners_1v.size());
+        Profiler::instance().count(Counter::TrackingFailures);
         invalidateFace();
     }
 }
@@ -440,25 +617,68 @@ void RPPG::updateROI() {
 }
 
 void RPPG::updateMask(Mat &frameGray) {
-    mask = Mat::zeros(frameGray.size(), frameGray.type());
+    PROFILE_STAGE(Stage::Mask);
+    // Redrawn in place, the buffer is only allocated when the frame size changes
+    mask.create(frameGray.size());
+    mask.setTo(ZERO);
     rectangle(mask, this->roi, WHITE, FILLED);
 }
 
+void RPPG::reset() {
+
+    invalidateFace();
+    timeOrigin = -1;
+    process_time = 0;
+    lastScanTime = 0;
+    lastSamplingTime = 0;
+    lastRespTime = 0;
+}
+
 void RPPG::invalidateFace() {
 
     s = Mat1d();
     s_f = Mat1d();
-    t = Mat1d();
+    t = Mat1i();
     re = Mat1b();
+    mo = Mat1d();
+    s_w = Mat1d();
+    jumps = Mat1b();
+    jumps_w = Mat1b();
     powerSpectrum = Mat1d();
+    bpms = Mat1d();
+    confidences = Mat1d();
+    qualities = Mat1d();
+    signalGood = false;
+    firstSampleTime = -1;
+    bpmPublished = false;
+    beatFilter.reset();
+    beatSamples = 0;
+    beatDetector.reset();
     faceValid = false;
 }
 
+void RPPG::updateJumps() {
+
+    // Frames with large motion are levelled out like rescans
+    jumps = (mo > MOTION_JUMP_THRESHOLD) / 255;
+    bitwise_or(jumps, re, jumps);
+}
+
+bool RPPG::motionSuppressed() {
+
+    int window = min(mo.rows, max(1, (int)(fps * MOTION_WINDOW)));
+    double vmin, vmax;
+    minMaxLoc(mo.rowRange(mo.rows - window, mo.rows), &vmin, &vmax);
+    return vmax > MOTION_SUPPRESS_THRESHOLD;
+}
+
 void RPPG::extractSignal_g() {
 
+    PROFILE_STAGE(Stage::Extract);
+
     // Denoise
-    Mat s_den = Mat(s.rows, 1, CV_64F);
-    denoise(s.col(1), re, s_den);
+    Mat s_den = Mat(s_w.rows, 1, CV_64F);
+    denoise(s_w.col(1), jumps_w, s_den);
 
     // Normalise
     normalization(s_den, s_den);
@@ -477,24 +697,26 @@ void RPPG::extractSignal_g() {
 
 void RPPG::extractSignal_pca() {
 
+    PROFILE_STAGE(Stage::Extract);
+
     // Denoise signals
-    Mat s_den = Mat(s.rows, s.cols, CV_64F);
-    denoise(s, re, s_den);
+    Mat s_den = Mat(s_w.rows, s_w.cols, CV_64F);
+    denoise(s_w, jumps_w, s_den);
 
     // Normalize signals
     normalization(s_den, s_den);
 
     // Detrend
-    Mat s_det = Mat(s.rows, s.cols, CV_64F);
+    Mat s_det = Mat(s_w.rows, s_w.cols, CV_64F);
     detrend(s_den, s_det, fps);
 
     // PCA to reduce dimensionality
-    Mat s_pca = Mat(s.rows, 1, CV_32F);
-    Mat pc = Mat(s.rows, s.cols, CV_32F);
+    Mat s_pca = Mat(s_w.rows, 1, CV_32F);
+    Mat pc = Mat(s_w.rows, s_w.cols, CV_32F);
     pcaComponent(s_det, s_pca, pc, low, high);
 
     // Moving average
-    Mat s_mav = Mat(s.rows, 1, CV_32F);
+    Mat s_mav = Mat(s_w.rows, 1, CV_32F);
     movingAverage(s_pca, s_mav, 3, fmax(floor(fps/6), 2));
 
     s_mav.copyTo(s_f);    
@@ -502,28 +724,30 @@ void RPPG::extractSignal_pca() {
 
 void RPPG::extractSignal_xminay() {
 
+    PROFILE_STAGE(Stage::Extract);
+
     // Denoise signals
-    Mat s_den = Mat(s.rows, s.cols, CV_64F);
-    denoise(s, re, s_den);
+    Mat s_den = Mat(s_w.rows, s_w.cols, CV_64F);
+    denoise(s_w, jumps_w, s_den);
 
     // Normalize raw signals
     Mat s_n = Mat(s_den.rows, s_den.cols, CV_64F);
     normalization(s_den, s_n);
 
     // Calculate X_s signal
-    Mat x_s = Mat(s.rows, s.cols, CV_64F);
+    Mat x_s = Mat(s_w.rows, s_w.cols, CV_64F);
     addWeighted(s_n.col(0), 3, s_n.col(1), -2, 0, x_s);
 
     // Calculate Y_s signal
-    Mat y_s = Mat(s.rows, s.cols, CV_64F);
+    Mat y_s = Mat(s_w.rows, s_w.cols, CV_64F);
     addWeighted(s_n.col(0), 1.5, s_n.col(1), 1, 0, y_s);
     addWeighted(y_s, 1, s_n.col(2), -1.5, 0, y_s);
 
     // Bandpass
-    Mat x_f = Mat(s.rows, s.cols, CV_32F);
+    Mat x_f = Mat(s_w.rows, s_w.cols, CV_32F);
     bandpass(x_s, x_f, low, high);
     x_f.convertTo(x_f, CV_64F);
-    Mat y_f = Mat(s.rows, s.cols, CV_32F);
+    Mat y_f = Mat(s_w.rows, s_w.cols, CV_32F);
     bandpass(y_s, y_f, low, high);
     y_f.convertTo(y_f, CV_64F);
 
@@ -537,7 +761,7 @@ void RPPG::extractSignal_xminay() {
     double alpha = stddev_x_f.val[0]/stddev_y_f.val[0];
 
     // Calculate signal
-    Mat xminay = Mat(s.rows, 1, CV_64F);
+    Mat xminay = Mat(s_w.rows, 1, CV_64F);
     addWeighted(x_f, 1, y_f, -alpha, 0, xminay);
 
     // Moving average
@@ -547,6 +771,8 @@ void RPPG::extractSignal_xminay() {
 
 void RPPG::estimateHeartrate() {
 
+    PROFILE_STAGE(Stage::Estimate);
+
     powerSpectrum = cv::Mat(s_f.size(), CV_32F);
     timeToFrequency(s_f, powerSpectrum, true);
 
@@ -558,23 +784,152 @@ void RPPG::estimateHeartrate() {
     if (!powerSpectrum.empty()) {
 
         // grab index of max power spectrum
-        double min, max;
+        double vmin, vmax;
         Point pmin, pmax;
-        minMaxLoc(powerSpectrum, &min, &max, &pmin, &pmax, bandMask);
+        minMaxLoc(powerSpectrum, &vmin, &vmax, &pmin, &pmax, bandMask);
 
         // calculate BPM
         bpm = pmax.y * fps / total * SEC_PER_MIN;
+        confidence = 1.0;
+        quality = spectralQuality(powerSpectrum, min(low, total), min(high, total), pmax.y);
+
+        if (acceptEstimate()) {
+            bpms.push_back(bpm);
+            confidences.push_back(confidence);
+            qualities.push_back(quality);
+        }
+    }
+
+    publishBpm();
+}
+
+void RPPG::estimateProgressive() {
+
+    PROFILE_STAGE(Stage::Estimate);
+
+    // Short window for responsiveness, whole buffer for stability; both zero-padded
+    // to the full window length so their estimates share one frequency grid
+    const int total = s_f.rows;
+    const int nfft = getOptimalDFTSize((int)(fps * minSignalSize));
+    const int windows[] = { min((int)(fps * earlySignalSize), total), total };
+
+    double sum = 0.0, weights = 0.0;
+    double lowest = HIGH_BPM, highest = 0.0;
+    for (int length : windows) {
+        // Quality is taken from the longest window
+        double estimate = dominantFrequency(s_f.rowRange(total - length, total), fps, LOW_BPM, HIGH_BPM, nfft, &quality);
+        sum += length * estimate;
+        weights += length;
+        lowest = min(lowest, estimate);
+        highest = max(highest, estimate);
+    }
+
+    if (weights == 0 || sum == 0) {
+        return;
+    }
+    bpm = sum / weights;
+
+    // Confidence grows with buffer fill and agreement between windows
+    double fill = total / (fps * minSignalSize);
+    double agreement = 1.0 - (highest - lowest) / bpm;
+    confidence = std::min(fill, 1.0) * std::max(agreement, 0.0);
+
+    if (acceptEstimate()) {
         bpms.push_back(bpm);
+        confidences.push_back(confidence);
+        qualities.push_back(quality);
+    }
+
+    publishBpm();
+}
+
+bool RPPG::acceptEstimate() {
+
+    bool good = quality >= MIN_SIGNAL_QUALITY;
+    if (good != signalGood) {
+        signalGood = good;
+        info = good ? "Signal acquired" : "Poor signal, please hold still";
+        emit sendInfo(info);
     }
+    return good;
+}
 
-    if ((process_time - lastSamplingTime) * timeBase * time_correction >= 1/samplingFrequency) {
-        lastSamplingTime = get_current_time();
+void RPPG::publishBpm() {
+
+    if (bpms.empty()) {
+        return;
+    }
+
+    // The first reading is published right away, later ones once per sampling period
+    if (!bpmPublished || (process_time - lastSamplingTime) * timeBase >= 1/samplingFrequency) {
+        lastSamplingTime = process_time;
         cv::sort(bpms, bpms, SORT_EVERY_COLUMN);
         // average calculated BPMs since last sampling time
         meanBpm = mean(bpms)(0);
+        meanConfidence = mean(confidences)(0);
+        meanQuality = mean(qualities)(0);
         minBpm = bpms.at<double>(0, 0);
         maxBpm = bpms.at<double>(bpms.rows-1, 0);
         bpms.pop_back(bpms.rows);
+        confidences.pop_back(confidences.rows);
+        qualities.pop_back(qualities.rows);
+
+        if (!bpmPublished) {
+            bpmPublished = true;
+            timeToFirstBpm = (process_time - firstSampleTime) * timeBase;
+            info = QString("First reading after %1 s").arg(timeToFirstBpm, 0, 'f', 1);
+            emit sendInfo(info);
+        }
+    }
+}
+
+void RPPG::estimateRespiration() {
+
+    // Raw green trace of the whole buffer, levelled at the same jumps as heart rate
+    Mat s_den = Mat(s.rows, 1, CV_64F);
+    denoise(s.col(1), jumps, s_den);
+
+    // Average down to a few samples per second, breathing sits far below that
+    int factor = max(1, cvRound(fps / RESP_SAMPLE_RATE));
+    double rate = fps / factor;
+    Mat s_dec;
+    cv::resize(s_den, s_dec, Size(1, max(1, s_den.rows / factor)), 0, 0, INTER_AREA);
+    if (s_dec.rows < 3) {
+        return;
+    }
+
+    // Normalise and remove the slow drift below the breathing band
+    normalization(s_dec, s_dec);
+    Mat s_det = Mat(s_dec.rows, 1, CV_64F);
+    detrend(s_dec, s_det, RESP_DETREND_LAMBDA);
+
+    double quality;
+    double rpm = dominantFrequency(s_det, rate, LOW_RPM, HIGH_RPM, 0, &quality);
+
+    if (quality >= MIN_SIGNAL_QUALITY) {
+        respirationRate = rpm;
+        respirationQuality = quality;
+    }
+}
+
+void RPPG::detectBeat(double green, int time, bool jump) {
+
+    // Beats come from a causally filtered copy of the green channel, sample by sample, so a
+    // peak is final when it is reported; s_f is refiltered over the whole window every frame
+    beatY[0] = beatY[1];
+    beatY[1] = beatY[2];
+    beatY[2] = beatFilter.update(green, time, jump);
+    beatT[0] = beatT[1];
+    beatT[1] = beatT[2];
+    beatT[2] = time;
+    if (beatSamples < 3 && ++beatSamples < 3) {
+        return;
+    }
+
+    // A beat is reported one sample after its peak, and only while the window passes the quality gate
+    Beat beat;
+    if (beatDetector.update(beatY, beatT, beat) && signalGood) {
+        emit sendBeat(beat, beatDetector.hrv());
     }
 }
 
@@ -654,23 +1009,23 @@ void RPPG::estimateHeartrate() {
     }
 }*/
 
-void RPPG::draw(cv::Mat &frameRGB) {
-    // Draw roi
-    rectangle(frameRGB, roi, cv::Scalar(0, 255, 0), 2);
+void RPPG::updateOverlay() {
 
-    // Draw bounding box
-    rectangle(frameRGB, box, cv::Scalar(0, 0, 255), 2);
+    Overlay &next = nextOverlay;
+    next.clear();
 
-    // Draw signal
+    // Roi and bounding box
+    next.boxes.push_back({roi, cv::Scalar(0, 255, 0), 2});
+    next.boxes.push_back({box, cv::Scalar(0, 0, 255), 2});
+
+    // Signal
     if (!s_f.empty()) {
         // Display of signals with fixed dimensions
         double displayHeight = box.height/2.0;
         double displayWidth = box.width*0.8;
 
-        // Draw signal with improved visibility
         double vmin, vmax;
-        Point pmin, pmax;
-        minMaxLoc(s_f, &vmin, &vmax, &pmin, &pmax);
+        minMaxLoc(s_f, &vmin, &vmax);
 
         if (vmax > vmin) {  // Check to avoid division by zero
             double heightMult = displayHeight/(vmax - vmin);
@@ -678,76 +1033,57 @@ void RPPG::draw(cv::Mat &frameRGB) {
             double drawAreaTlX = box.tl().x + box.width*0.1;
             double drawAreaTlY = box.tl().y - box.height/2 - 10;
 
-            // Draw background for better visibility
-            Point bgTL(drawAreaTlX - 5, drawAreaTlY - 5);
-            Point bgBR(drawAreaTlX + displayWidth + 5, drawAreaTlY + displayHeight + 5);
-            rectangle(frameRGB, bgTL, bgBR, cv::Scalar(32, 32, 32), -1);
-
-            // Draw zero line
-            double zeroY = drawAreaTlY + displayHeight/2;
-            line(frameRGB,
-                 Point(drawAreaTlX, zeroY),
-                 Point(drawAreaTlX + displayWidth, zeroY),
-                 cv::Scalar(0, 128, 0), 1);
-
-            // Draw signal
-            Point p1(drawAreaTlX, drawAreaTlY + (vmax - s_f.at<double>(0, 0))*heightMult);
-            Point p2;
-
-            for (int i = 1; i < s_f.rows; i++) {
-                p2 = Point(drawAreaTlX + i * widthMult,
-                           drawAreaTlY + (vmax - s_f.at<double>(i, 0))*heightMult);
-                line(frameRGB, p1, p2, cv::Scalar(255, 0, 100), 2);
-                p1 = p2;
-            }
+            // Background, zero line and border
+            next.signalArea = Rect(Point(drawAreaTlX - 5, drawAreaTlY - 5),
+                                   Point(drawAreaTlX + displayWidth + 5, drawAreaTlY + displayHeight + 5));
+            next.boxes.push_back({next.signalArea, cv::Scalar(32, 32, 32), -1});
+            next.boxes.push_back({Rect(drawAreaTlX, drawAreaTlY + displayHeight/2, displayWidth, 0), cv::Scalar(0, 128, 0), 1});
+            next.boxes.push_back({next.signalArea, cv::Scalar(128, 128, 128), 1});
 
-            // Draw border around signal area
-            rectangle(frameRGB, bgTL, bgBR, cv::Scalar(128, 128, 128), 1);
+            for (int i = 0; i < s_f.rows; i++) {
+                next.signal.push_back(Point2f(drawAreaTlX + i * widthMult,
+                                              drawAreaTlY + (vmax - s_f.at<double>(i, 0))*heightMult));
+            }
         }
     }
+    next.signalColor = cv::Scalar(255, 0, 100);
 
-    // Draw BPM text with improved visibility
-    if (faceValid) {
-        std::stringstream ss;
-        ss << std::fixed << std::setprecision(0) << meanBpm;
-
-        if(meanBpm < MAX_BPM && meanBpm > MIN_BPM) {
-            // Draw background for text
-            cv::Size textSize = getTextSize(ss.str(), FONT_HERSHEY_PLAIN, 8, 8, nullptr);
-            Point textBgTL(box.tl().x + 5, box.tl().y + box.height - textSize.height - 15);
-            Point textBgBR(textBgTL.x + textSize.width + 10, textBgTL.y + textSize.height + 10);
-            rectangle(frameRGB, textBgTL, textBgBR, cv::Scalar(0, 0, 0), -1);
-
+    // BPM text, formatted only when the rounded value changes
+    int shown = (faceValid && meanBpm < MAX_BPM && meanBpm > MIN_BPM) ? cvRound(meanBpm) : 0;
+    if (shown != shownBpm) {
+        shownBpm = shown;
+        bpmText = shown > 0 ? std::to_string(shown) : std::string();
+    }
 #if defined (Q_OS_ANDROID)
-            putText(frameRGB, ss.str(),
-                    Point(box.tl().x + 10, box.tl().y + box.height - 10),
-                    FONT_HERSHEY_PLAIN, 12, cv::Scalar(255, 0, 100), 12);
+    const int bpmHeight = 140;
 #else
-            putText(frameRGB, ss.str(),
-                    Point(box.tl().x + 10, box.tl().y + box.height - 10),
-                    FONT_HERSHEY_PLAIN, 8, cv::Scalar(255, 0, 100), 8);
+    const int bpmHeight = 96;
 #endif
-        }
+    next.labels.push_back({bpmText, Point(box.tl().x + 10, box.tl().y + box.height - 10),
+                           cv::Scalar(255, 0, 100), bpmHeight, true});
+
+    // FPS text
+    int shownFps10 = cvRound(fps * 10);
+    if (shownFps10 != shownFps) {
+        shownFps = shownFps10;
+        fpsText = cv::format("%.1f fps", shownFps10 / 10.0);
     }
+    next.labels.push_back({fpsText, Point(box.tl().x, box.br().y + 60), cv::Scalar(0, 255, 0), 48, false});
 
-    // Draw FPS text
-    std::stringstream ss;
-    ss.str("");
-    ss << std::fixed << std::setprecision(1) << fps << " fps";
-    putText(frameRGB, ss.str(),
-            Point(box.tl().x, box.br().y + 60),
-            FONT_HERSHEY_PLAIN, 4, cv::Scalar(0, 255, 0), 4);
+    // Corners
+    next.corners = corners;
+    next.cornerColor = cv::Scalar(0, 255, 0);
 
-    // Draw corners
-    for (const auto& corner : corners) {
-        line(frameRGB,
-             Point(corner.x-5, corner.y),
-             Point(corner.x+5, corner.y),
-             cv::Scalar(0, 255, 0), 2);
-        line(frameRGB,
-             Point(corner.x, corner.y-5),
-             Point(corner.x, corner.y+5),
-             cv::Scalar(0, 255, 0), 2);
+    if (!next.sameContent(overlay)) {
+        next.version = overlay.version + 1;
+        std::swap(overlay, next);
     }
 }
 
+void RPPG::clearOverlay() {
+
+    if (!overlay.boxes.empty() || !overlay.labels.empty()) {
+        overlay.clear();
+        overlay.version++;
+    }
+}
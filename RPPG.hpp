@@ -1,7 +1,6 @@
 #ifndef RPPG_hpp
 #define RPPG_hpp
 
-#include <fstream>
 #include <string>
 #include <stdio.h>
 #include <iostream>
@@ -11,11 +10,14 @@
 #include <limits>
 #include <string>
 #include <algorithm>
+#include <future>
 #include <QDebug>
 #include <QCamera>
 #include <QDateTime>
-#include <QStandardPaths>
 #include <opencv2/opencv.hpp>
+#include "beatdetector.h"
+#include "overlay.h"
+#include "roitrace.h"
 
 #define DEFAULT_RPPG_ALGORITHM "g"
 #define DEFAULT_FACEDET_ALGORITHM "haar"
@@ -25,13 +27,25 @@
 
 #define MIN_BPM 40
 #define MAX_BPM 240
+#define DEFAULT_EARLY_SIGNAL_SIZE 2 // progressive estimates start here
 #define DEFAULT_MIN_SIGNAL_SIZE 5
 #define DEFAULT_MAX_SIGNAL_SIZE 15
+#define DEFAULT_RESP_MIN_SIGNAL_SIZE 15
+#define DEFAULT_RESP_SIGNAL_SIZE 30
+#define LOW_RPM 6 // breaths per minute
+#define HIGH_RPM 30
+#define RESP_SAMPLE_RATE 4 // Hz after decimation
+#define RESP_DETREND_LAMBDA 60 // cuts off near 5 breaths/min at RESP_SAMPLE_RATE
+#define MIN_SIGNAL_QUALITY -3.0 // dB, windows below are not averaged
+#define MOTION_JUMP_THRESHOLD 0.03 // per frame motion treated as a jump by denoise
+#define MOTION_SUPPRESS_THRESHOLD 0.08 // recent motion above this suspends estimation
+#define MOTION_WINDOW 0.5 // seconds
+#define SIGNAL_RESERVE_FPS 60 // signal buffers are sized up front for frame rates up to this
 
 
-#define HAAR_CLASSIFIER_PATH "haarcascade_frontalface_alt.xml"
-#define DNN_PROTO_PATH "deploy.prototxt"
-#define DNN_MODEL_PATH "res10_300x300_ssd_iter_140000.caffemodel"
+#define HAAR_CLASSIFIER_PATH ":/opencv/haarcascade_frontalface_alt.xml"
+#define DNN_PROTO_PATH ":/opencv/deploy.prototxt"
+#define DNN_MODEL_PATH ":/opencv/res10_300x300_ssd_iter_140000.caffemodel"
 
 
 using namespace cv;
@@ -47,42 +61,70 @@ class RPPG : public QObject
 
 public:
     explicit RPPG(QObject *parent = nullptr);
-    // Load Settings
-    bool load(int camIndex, const string &haarPath, const string &dnnProtoPath, const string &dnnModelPath);
-    double processFrame(Mat &frameRGB, Mat &frameGray);
+    // Load Settings, model paths are Qt resource paths
+    bool load(const string &haarPath, const string &dnnProtoPath, const string &dnnModelPath);
+    // timestamp is the frame's capture time in milliseconds
+    double processFrame(Mat &frameRGB, Mat &frameGray, int64_t timestamp);
+    // Drops the signal and the stream's time origin, for a new camera or stream
+    void reset();
+    double getConfidence() const { return meanConfidence; }
+    double getQuality() const { return meanQuality; }
+    double getRespirationRate() const { return respirationRate; }
+    // Annotations of the last processed frame, drawn by the caller
+    const Overlay &getOverlay() const { return overlay; }
+    double getTimeToFirstBpm() const { return timeToFirstBpm; }
+    double getFrameRate() const { return fps; }
+    // Switches the face detector, its model is loaded in the background on first use
+    void setFaceDetAlgorithm(faceDetAlgorithm alg);
+    // True once the selected detector's model has loaded
+    bool detectorReady();
+    // Use this box instead of running the detector, for input with known geometry.
+    // An empty box hands detection back to the classifier.
+    void setFaceBox(const Rect &box) { injectedBox = box; }
+    // Every sample added to the signal buffers is also appended here, nullptr to stop
+    void setRecorder(RoiTraceWriter *recorder) { this->recorder = recorder; }
+    // Replay of recorded samples through the buffer and estimation half of processFrame.
+    // The samples stay in the caller's arrays and the signal buffers become views
+    // into them, so nothing is copied. Rows up to index are valid, reset marks the first
+    // sample after the face was lost, and estimation can be skipped between readings.
+    void replaySample(const Mat1d &means, const Mat1i &times, const Mat1b &rescans, const Mat1d &motions,
+                      int index, bool reset, bool estimateNow);
+    // Number of leading rows the replay window has left behind. The window is counted from
+    // row 0 afterwards, so the caller must remove those rows before the next replaySample.
+    int dropReplayRows();
+    double getBpm() const { return meanBpm; }
     void exit();
 
 private:
 
     typedef vector<Point2f> Contour2f;
 
+    void startLoading(faceDetAlgorithm alg);
+    bool readDetector(faceDetAlgorithm alg);
+    void updateFrameSize(const Size &size);
+    void addSample(const RoiSample &sample);
+    void estimate();
     void detectFace(Mat &frameRGB, Mat &frameGray);
     void setNearestBox(vector<Rect> boxes);
     void detectCorners(Mat &frameGray);
     void trackFace(Mat &frameGray);
     void updateMask(Mat &frameGray);
     void updateROI();
+    void updateJumps();
+    bool motionSuppressed();
     void extractSignal_g();
     void extractSignal_pca();
     void extractSignal_xminay();
     void estimateHeartrate();
-    void draw(Mat &frameRGB);
+    void estimateProgressive();
+    bool acceptEstimate();
+    void publishBpm();
+    void estimateRespiration();
+    void detectBeat(double green, int time, bool jump);
+    void updateOverlay();
+    void clearOverlay();
     void invalidateFace();
 
-    int get_current_time()
-    {
-        int64 tickCount = cv::getTickCount();
-        double timeInMilliseconds = (tickCount * 1000.0 / time_correction) / cv::getTickFrequency();
-
-        // Check for overflow before casting to int
-        if (timeInMilliseconds < std::numeric_limits<int>::min() || timeInMilliseconds > std::numeric_limits<int>::max())
-        {
-            qDebug() << "Error : overflow int.";
-            return 0;
-        }
-        return static_cast<int>(timeInMilliseconds);
-    }
-
     static bool to_bool(string s) {
         bool result;
         transform(s.begin(), s.end(), s.begin(), ::tolower);
@@ -120,26 +162,40 @@ private:
     CascadeClassifier haarClassifier;
     Net dnnClassifier;
 
+    // Background model loading, indexed by faceDetAlgorithm
+    string haarPath;
+    string dnnProtoPath;
+    string dnnModelPath;
+    future<bool> detectorLoading[2];
+    bool detectorLoaded[2] = {false, false};
+    int64 loadStart[2] = {0, 0};
+
     // Settings
+    Size frameSize;
     Size minFaceSize;
     int maxSignalSize;
     int minSignalSize;
+    int earlySignalSize;
+    int respSignalSize;
+    int respMinSignalSize;
     double rescanFrequency;
     double samplingFrequency;
     double timeBase;
     bool guiMode;
 
     // State variables
-    int time_correction = 1;
+    int64_t timeOrigin = -1;
     int process_time= 0;
     int lastSamplingTime= 0;
     int lastScanTime= 0;
-    double fps;
+    int lastRespTime= 0;
+    double fps = 0.0;
     int high;
     int low;
     int64_t now;
     bool faceValid;
     bool rescanFlag;
+    double motion = 0.0;
 
     // Tracking
     Mat lastFrameGray;
@@ -147,28 +203,74 @@ private:
 
     // Mask
     Rect box;
+    Rect injectedBox;
     Mat1b mask;
     Rect roi;
 
     // Raw signal
+    RoiTraceWriter *recorder = nullptr;
     Mat1d s;
-    Mat1d t;
+    Mat1i t;
     Mat1b re;
+    Mat1d mo;
+    int replayStart = 0;
+
+    // Jumps for denoising: rescans and large motion
+    Mat1b jumps;
+
+    // Heart rate window: newest part of the raw buffer
+    Mat1d s_w;
+    Mat1b jumps_w;
 
     // Estimation
     Mat1d s_f;
     Mat1d bpms;
+    Mat1d confidences;
+    Mat1d qualities;
     Mat1d powerSpectrum;
     double bpm = 0.0;
-    double meanBpm;
+    double confidence = 0.0;
+    double quality = 0.0;
+    bool signalGood = false;
+    double meanBpm = 0.0;
+    double meanConfidence = 0.0;
+    double meanQuality = 0.0;
     double minBpm;
     double maxBpm;    
 
+    // Respiration
+    double respirationRate = 0.0;
+    double respirationQuality = 0.0;
+
+    // Time to first reading
+    int firstSampleTime = -1;
+    bool bpmPublished = false;
+    double timeToFirstBpm = -1.0;
+
+    // Beat-to-beat, on the three newest samples of the causal stream
+    BeatFilter beatFilter;
+    double beatY[3] = {0, 0, 0};
+    double beatT[3] = {0, 0, 0};
+    int beatSamples = 0;
+    BeatDetector beatDetector;
+
+    // Annotations
+    Overlay overlay;
+    Overlay nextOverlay;
+    int shownBpm = -1;
+    int shownFps = -1;
+    std::string bpmText;
+    std::string fpsText;
+
     QString info{};
 
 signals:
     void sendInfo(QString);
+    void sendBeat(Beat, HrvStats);
 };
 
+Q_DECLARE_METATYPE(Beat);
+Q_DECLARE_METATYPE(HrvStats);
+
 
 #endif /* RPPG_hpp */
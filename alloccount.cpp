@@ -0,0 +1,129 @@
+#include "alloccount.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <opencv2/core.hpp>
+
+using namespace cv;
+
+// One slot per stage plus one for allocations outside any stage
+#define STAGE_SLOTS ((int)Stage::Count + 1)
+
+static std::atomic<uint64_t> heapAllocs[STAGE_SLOTS];
+static std::atomic<uint64_t> heapBytes[STAGE_SLOTS];
+static std::atomic<uint64_t> matAllocs[STAGE_SLOTS];
+static std::atomic<uint64_t> matBytes[STAGE_SLOTS];
+
+void *operator new(std::size_t size) {
+    int stage = (int)ScopedStageTimer::current();
+    heapAllocs[stage].fetch_add(1, std::memory_order_relaxed);
+    heapBytes[stage].fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// Counts Mat data buffers and hands everything else to OpenCV's standard allocator.
+// Buffers remember the allocator that created them, so they are freed by the base directly.
+class CountingMatAllocator : public MatAllocator
+{
+public:
+    explicit CountingMatAllocator(MatAllocator *base) : base(base) {}
+
+    UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                       AccessFlag flags, UMatUsageFlags usageFlags) const override {
+        UMatData *u = base->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (u && !data) {
+            int stage = (int)ScopedStageTimer::current();
+            matAllocs[stage].fetch_add(1, std::memory_order_relaxed);
+            matBytes[stage].fetch_add(u->size, std::memory_order_relaxed);
+        }
+        return u;
+    }
+
+    bool allocate(UMatData *data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const override {
+        return base->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(UMatData *data) const override {
+        base->deallocate(data);
+    }
+
+private:
+    MatAllocator *base;
+};
+
+namespace alloccount {
+
+void install() {
+    static CountingMatAllocator allocator(Mat::getStdAllocator());
+    Mat::setDefaultAllocator(&allocator);
+}
+
+AllocCounts snapshot() {
+    AllocCounts counts;
+    for (int i = 0; i < STAGE_SLOTS; i++) {
+        AllocCounts stage = snapshot((Stage)i);
+        counts.heapAllocs += stage.heapAllocs;
+        counts.heapBytes += stage.heapBytes;
+        counts.matAllocs += stage.matAllocs;
+        counts.matBytes += stage.matBytes;
+    }
+    return counts;
+}
+
+AllocCounts snapshot(Stage stage) {
+    int i = (int)stage;
+    AllocCounts counts;
+    counts.heapAllocs = heapAllocs[i].load(std::memory_order_relaxed);
+    counts.heapBytes = heapBytes[i].load(std::memory_order_relaxed);
+    counts.matAllocs = matAllocs[i].load(std::memory_order_relaxed);
+    counts.matBytes = matBytes[i].load(std::memory_order_relaxed);
+    return counts;
+}
+
+std::string report(uint64_t frames) {
+    std::string text;
+    char line[128];
+    snprintf(line, sizeof(line), "%-10s %9s %9s %9s %9s\n", "per frame", "heap", "heap B", "mat", "mat B");
+    text += line;
+    if (frames == 0) {
+        return text;
+    }
+    for (int i = 0; i < STAGE_SLOTS; i++) {
+        AllocCounts c = snapshot((Stage)i);
+        if (c.heapAllocs == 0 && c.matAllocs == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "%-10s %9.2f %9.0f %9.2f %9.0f\n",
+                 i < (int)Stage::Count ? stageName((Stage)i) : "other",
+                 (double)c.heapAllocs / frames, (double)c.heapBytes / frames,
+                 (double)c.matAllocs / frames, (double)c.matBytes / frames);
+        text += line;
+    }
+    return text;
+}
+
+}
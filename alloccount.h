@@ -0,0 +1,39 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <cstdint>
+#include <string>
+#include "profiler.h"
+
+// Process wide allocation counters, attributed to the innermost PROFILE_STAGE scope
+// active on the allocating thread, so a stage's counts exclude the stages nested in it.
+// Heap counts come from a replaced global operator new and include the small
+// bookkeeping object OpenCV creates per Mat buffer. Mat counts come from a
+// cv::MatAllocator installed as OpenCV's default and cover Mat data buffers.
+// Scratch memory OpenCV takes through cv::fastMalloc directly is not seen.
+// Linking alloccount.cpp replaces operator new for the whole program, so it is only part of
+// the benchmarks and of builds with CONFIG+=allocations.
+struct AllocCounts {
+    uint64_t heapAllocs = 0;
+    uint64_t heapBytes = 0;
+    uint64_t matAllocs = 0;
+    uint64_t matBytes = 0;
+};
+
+namespace alloccount {
+
+    // Install the counting Mat allocator, call before the first Mat is created
+    void install();
+
+    // Totals, including allocations made outside any stage
+    AllocCounts snapshot();
+
+    // Allocations made inside stage; Stage::Count gives those outside any stage
+    AllocCounts snapshot(Stage stage);
+
+    // Per-frame averages over frames, one line per stage that allocated
+    std::string report(uint64_t frames);
+
+}
+
+#endif // ALLOCCOUNT_H
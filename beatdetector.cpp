@@ -0,0 +1,135 @@
+#include "beatdetector.h"
+#include <cmath>
+
+#define LEVEL_ALPHA 0.05
+#define PEAK_THRESHOLD 0.5
+#define NN50_MS 50.0
+#define TWO_PI 6.283185307179586
+
+BeatFilter::BeatFilter(double lowHz, double highHz)
+    : lowHz(lowHz)
+    , highHz(highHz)
+{
+}
+
+void BeatFilter::reset()
+{
+    baseline = 0.0;
+    smoothed[0] = 0.0;
+    smoothed[1] = 0.0;
+    lastTime = -1.0;
+}
+
+double BeatFilter::update(double x, double time, bool jump)
+{
+    if (lastTime < 0 || jump) {
+        baseline = x;
+        lastTime = time;
+        return smoothed[1];
+    }
+
+    // One-pole coefficients for this step: 1 - exp(-2 pi f dt)
+    double dt = (time - lastTime) / 1000.0;
+    lastTime = time;
+    baseline += (1.0 - std::exp(-TWO_PI * lowHz * dt)) * (x - baseline);
+    double a = 1.0 - std::exp(-TWO_PI * highHz * dt);
+    smoothed[0] += a * (x - baseline - smoothed[0]);
+    smoothed[1] += a * (smoothed[0] - smoothed[1]);
+    return smoothed[1];
+}
+
+BeatDetector::BeatDetector(double minIbi, double maxIbi)
+    : minIbi(minIbi)
+    , maxIbi(maxIbi)
+{
+}
+
+void BeatDetector::reset()
+{
+    level = 0.0;
+    spread = 0.0;
+    primed = false;
+    lastBeatTime = -1.0;
+    lastIbi = 0.0;
+    n = 0;
+    mean = 0.0;
+    m2 = 0.0;
+    nDiff = 0;
+    sumSqDiff = 0.0;
+    nn50 = 0;
+}
+
+bool BeatDetector::update(const double y[3], const double t[3], Beat &beat)
+{
+    // Track signal level and spread to get an amplitude independent threshold
+    if (!primed) {
+        level = y[2];
+        spread = 0.0;
+        primed = true;
+    } else {
+        level += LEVEL_ALPHA * (y[2] - level);
+        spread += LEVEL_ALPHA * (std::fabs(y[2] - level) - spread);
+    }
+
+    // Local maximum above threshold
+    if (!(y[1] > y[0] && y[1] >= y[2]) || y[1] < level + PEAK_THRESHOLD * spread) {
+        return false;
+    }
+
+    // Sub-sample peak position by parabolic interpolation
+    double denom = y[0] - 2 * y[1] + y[2];
+    double delta = denom != 0 ? 0.5 * (y[0] - y[2]) / denom : 0.0;
+    if (delta > 0.5) delta = 0.5;
+    if (delta < -0.5) delta = -0.5;
+    double time = t[1] + delta * (delta > 0 ? t[2] - t[1] : t[1] - t[0]);
+
+    // Refractory period
+    if (lastBeatTime >= 0 && time - lastBeatTime < minIbi) {
+        return false;
+    }
+
+    beat.time = time;
+    beat.ibi = 0.0;
+    beat.bpm = 0.0;
+
+    if (lastBeatTime >= 0 && time - lastBeatTime <= maxIbi) {
+        beat.ibi = time - lastBeatTime;
+        beat.bpm = 60000.0 / beat.ibi;
+        addInterval(beat.ibi);
+    } else {
+        // Gap or first beat: do not chain successive differences across it
+        lastIbi = 0.0;
+    }
+
+    lastBeatTime = time;
+    return true;
+}
+
+void BeatDetector::addInterval(double ibi)
+{
+    n++;
+    double d = ibi - mean;
+    mean += d / n;
+    m2 += d * (ibi - mean);
+
+    if (lastIbi > 0) {
+        double diff = ibi - lastIbi;
+        sumSqDiff += diff * diff;
+        if (std::fabs(diff) > NN50_MS) nn50++;
+        nDiff++;
+    }
+    lastIbi = ibi;
+}
+
+HrvStats BeatDetector::hrv() const
+{
+    HrvStats stats;
+    stats.count = n;
+    stats.meanIbi = mean;
+    stats.sdnn = n > 1 ? std::sqrt(m2 / (n - 1)) : 0.0;
+    if (nDiff > 0) {
+        stats.rmssd = std::sqrt(sumSqDiff / nDiff);
+        stats.pnn50 = 100.0 * nn50 / nDiff;
+    }
+    return stats;
+}
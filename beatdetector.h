@@ -0,0 +1,82 @@
+#ifndef BEATDETECTOR_H
+#define BEATDETECTOR_H
+
+// One detected heart beat, timestamps in milliseconds of the frame clock
+struct Beat {
+    double time = 0.0;  // interpolated peak time
+    double ibi = 0.0;   // inter-beat interval, 0 if there is no valid predecessor
+    double bpm = 0.0;   // instantaneous rate from ibi
+};
+
+// Streaming heart rate variability statistics over all accepted intervals
+struct HrvStats {
+    int count = 0;      // number of intervals
+    double meanIbi = 0.0;
+    double rmssd = 0.0;
+    double sdnn = 0.0;
+    double pnn50 = 0.0; // percent of successive differences > 50 ms
+};
+
+// Causal band-pass for beat detection: a one-pole high-pass removes the baseline and two
+// cascaded one-pole low-passes the sensor noise. Coefficients follow each sample's time step, so frame
+// jitter does not move the band, and the output only depends on samples already seen.
+class BeatFilter
+{
+public:
+    BeatFilter(double lowHz, double highHz);
+
+    void reset();
+
+    // Filtered value of x at time in milliseconds. A jump restarts the baseline at x,
+    // so a step from a rescan or head motion is not mistaken for a beat.
+    double update(double x, double time, bool jump);
+
+private:
+    double lowHz;
+    double highHz;
+
+    double baseline = 0.0;
+    double smoothed[2] = {0.0, 0.0};
+    double lastTime = -1.0;
+};
+
+class BeatDetector
+{
+public:
+    explicit BeatDetector(double minIbi = 250.0, double maxIbi = 1500.0);
+
+    void reset();
+
+    // Feed the three newest samples of a filtered signal (oldest first) with their timestamps.
+    // Returns true and fills beat when y[1] is a new peak.
+    bool update(const double y[3], const double t[3], Beat &beat);
+
+    HrvStats hrv() const;
+
+private:
+    void addInterval(double ibi);
+
+    double minIbi;
+    double maxIbi;
+
+    // Adaptive threshold
+    double level = 0.0;
+    double spread = 0.0;
+    bool primed = false;
+
+    // Last accepted peak
+    double lastBeatTime = -1.0;
+    double lastIbi = 0.0;
+
+    // Welford accumulators for SDNN
+    int n = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    // Successive differences for RMSSD and pNN50
+    int nDiff = 0;
+    double sumSqDiff = 0.0;
+    int nn50 = 0;
+};
+
+#endif // BEATDETECTOR_H
@@ -0,0 +1,181 @@
+// Benchmark of fingertip PPG on a synthetic lit fingertip.
+//
+// Each frame is a red, saturated patch whose pulse channel follows a pulse with two
+// harmonics, slow drift from the finger warming the sensor and common noise, plus per-pixel
+// sensor noise. Frames go through ContactPPG::processFrame with jittered capture timestamps,
+// so accuracy and per-frame cost can be reproduced without a camera. --amplitude 0 gives a
+// pulse-free finger, where no reading should be published. Results go to stdout as JSON;
+// a summary goes to stderr.
+//
+// Usage: bench_contact [--seconds s] [--fps f] [--size WxH] [--bpm b] [--amplitude a] [--noise n]
+//                      [--drift d] [--jitter j] [--seed n] [--draw] [--max-error bpm]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "ContactPPG.hpp"
+
+using namespace cv;
+using namespace std;
+
+#define DEFAULT_SECONDS 60
+// Readings are scored once the window is full and the BPM smoothing has settled
+#define SCORE_AFTER_SECONDS (CONTACT_WINDOW_SIZE + 4)
+#define FINGER_RED 200
+#define FINGER_GREEN 40
+#define FINGER_PULSE_LEVEL 60 // mean of the pulse channel
+#define PIXEL_NOISE 2.0 // per-pixel sensor noise, also dithers the 8 bit levels
+
+struct FingerSettings {
+    Size size = Size(320, 240);
+    double fps = 30.0;
+    double bpm = 72.0;
+    double amplitude = 1.5; // grey levels of the fundamental on the pulse channel
+    double noise = 0.5;     // common noise standard deviation, grey levels
+    double drift = 0.8;     // grey levels per second
+    double jitter = 0.1;    // capture time standard deviation, fraction of a frame
+    unsigned seed = 1;
+};
+
+// Pulse with a sharp systolic upstroke: fundamental and two harmonics
+static double pulse(const FingerSettings &s, double time, double phase) {
+    double w = 2 * CV_PI * s.bpm / 60.0 * time + phase;
+    return -(sin(w) + 0.4 * sin(2 * w) + 0.15 * sin(3 * w));
+}
+
+// Percentile of sorted samples
+static double at(const vector<double> &sorted, double q) {
+    return sorted[min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--seconds s] [--fps f] [--size WxH] [--bpm b] [--amplitude a] [--noise n]\n"
+                    "       [--drift d] [--jitter j] [--seed n] [--draw] [--max-error bpm]\n", name);
+}
+
+int main(int argc, char **argv) {
+
+    FingerSettings settings;
+    double seconds = DEFAULT_SECONDS;
+    bool draw = false;
+    double maxError = -1.0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--draw")) {
+            draw = true;
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (!strcmp(arg, "--seconds")) seconds = atof(value);
+        else if (!strcmp(arg, "--fps")) settings.fps = atof(value);
+        else if (!strcmp(arg, "--size")) sscanf(value, "%dx%d", &settings.size.width, &settings.size.height);
+        else if (!strcmp(arg, "--bpm")) settings.bpm = atof(value);
+        else if (!strcmp(arg, "--amplitude")) settings.amplitude = atof(value);
+        else if (!strcmp(arg, "--noise")) settings.noise = atof(value);
+        else if (!strcmp(arg, "--drift")) settings.drift = atof(value);
+        else if (!strcmp(arg, "--jitter")) settings.jitter = atof(value);
+        else if (!strcmp(arg, "--seed")) settings.seed = (unsigned)atoi(value);
+        else if (!strcmp(arg, "--max-error")) maxError = atof(value);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    ContactPPG contact;
+    contact.setGuiMode(draw);
+
+    RNG rng(settings.seed);
+    const double phase = rng.uniform(0.0, 2 * CV_PI);
+    const int frames = (int)(seconds * settings.fps);
+
+    vector<double> processTimes;
+    processTimes.reserve(frames);
+    Mat level(settings.size, CV_32FC3);
+    Mat sensorNoise(settings.size, CV_32FC3);
+    Mat frameRGB;
+    double bpm = 0.0;
+    double errorSum = 0.0, errorMax = 0.0;
+    int scored = 0, unscored = 0;
+    int64_t lastTimestamp = -1;
+
+    for (int i = 0; i < frames; i++) {
+
+        // Capture time with jitter, kept increasing like a camera clock
+        double time = (i + rng.gaussian(settings.jitter)) / settings.fps;
+        int64_t timestamp = max((int64_t)llround(time * 1000), lastTimestamp + 1);
+        lastTimestamp = timestamp;
+
+        double pulseLevel = FINGER_PULSE_LEVEL + settings.amplitude * pulse(settings, time, phase)
+                            + settings.drift * time + rng.gaussian(settings.noise);
+        level.setTo(Scalar(FINGER_RED, FINGER_GREEN, pulseLevel));
+        rng.fill(sensorNoise, RNG::NORMAL, Scalar::all(0), Scalar::all(PIXEL_NOISE));
+        add(level, sensorNoise, level);
+        level.convertTo(frameRGB, CV_8U);
+
+        auto t0 = chrono::steady_clock::now();
+        bpm = contact.processFrame(frameRGB, timestamp);
+        auto t1 = chrono::steady_clock::now();
+        processTimes.push_back(chrono::duration<double, micro>(t1 - t0).count());
+
+        if (i / settings.fps >= SCORE_AFTER_SECONDS) {
+            if (bpm > 0) {
+                double error = fabs(bpm - settings.bpm);
+                errorSum += error;
+                errorMax = max(errorMax, error);
+                scored++;
+            } else {
+                unscored++;
+            }
+        }
+    }
+
+    vector<double> sorted = processTimes;
+    sort(sorted.begin(), sorted.end());
+    double busy = 0.0;
+    for (double v : sorted) {
+        busy += v * 1e-6;
+    }
+    double framesPerSecond = busy > 0 ? frames / busy : 0.0;
+    double meanError = scored > 0 ? errorSum / scored : -1.0;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"bench_contact\",\n");
+    printf("  \"settings\": {\"seconds\": %g, \"fps\": %g, \"width\": %d, \"height\": %d, \"bpm\": %g, "
+           "\"amplitude\": %g, \"noise\": %g, \"drift\": %g, \"jitter\": %g, \"seed\": %u, \"draw\": %s},\n",
+           seconds, settings.fps, settings.size.width, settings.size.height, settings.bpm,
+           settings.amplitude, settings.noise, settings.drift, settings.jitter, settings.seed,
+           draw ? "true" : "false");
+    printf("  \"frames\": %d,\n", frames);
+    printf("  \"frames_per_s\": %.1f,\n", framesPerSecond);
+    if (!sorted.empty()) {
+        printf("  \"latency\": {\"process\": {\"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}},\n",
+               at(sorted, 0.50), at(sorted, 0.95), at(sorted, 0.99), sorted.back());
+    }
+    printf("  \"bpm\": {\"final\": %.1f, \"mean_abs_error\": %.2f, \"max_abs_error\": %.2f, "
+           "\"scored_frames\": %d, \"frames_without_reading\": %d}\n",
+           bpm, meanError, errorMax, scored, unscored);
+    printf("}\n");
+
+    fprintf(stderr, "%d frames, %.1f frames/s, process p50 %.0f us p99 %.0f us, final %.1f bpm (truth %g), "
+            "MAE %.2f, %d of %d scored frames without a reading\n",
+            frames, framesPerSecond, sorted.empty() ? 0.0 : at(sorted, 0.50), sorted.empty() ? 0.0 : at(sorted, 0.99),
+            bpm, settings.bpm, meanError, unscored, scored + unscored);
+
+    if (maxError >= 0 && (scored == 0 || meanError > maxError)) {
+        fprintf(stderr, "BPM error above %g\n", maxError);
+        return 1;
+    }
+    return 0;
+}
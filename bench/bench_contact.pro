@@ -0,0 +1,39 @@
+# Fingertip PPG on a synthetic lit fingertip: accuracy and per-frame cost
+#   qmake bench_contact.pro && make && ./bench_contact --bpm 110 > bench_contact.json
+
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_contact
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../ContactPPG.cpp \
+    ../opencv.cpp \
+    bench_contact.cpp
+
+HEADERS += \
+    ../ContactPPG.hpp \
+    ../opencv.hpp \
+    ../slidingwindow.h
+
+win32 {
+    LIBS += -L$$(OPENCV_DIR)/lib -lopencv_world452
+    INCLUDEPATH += C:/opencv/build/include
+}
+
+unix:!macx {
+    INCLUDEPATH += /usr/local/include/opencv4
+    INCLUDEPATH += /usr/include/opencv4
+
+    LIBS += -lopencv_core -lopencv_highgui -lopencv_imgproc -lopencv_video
+}
+
+macx {
+    INCLUDEPATH += /usr/local/Cellar/opencv/4.10.0_12/include/opencv4
+    LIBS += -L/usr/local/Cellar/opencv/4.10.0_12/lib -lopencv_core -lopencv_highgui -lopencv_imgproc -lopencv_video
+}
@@ -0,0 +1,229 @@
+// Microbenchmarks for the signal processing kernels in opencv.cpp.
+//
+// Every kernel runs on a synthetic pulse signal of 1 to 60 seconds at 30 and 60 fps.
+// Results go to stdout as JSON so runs from different commits can be diffed;
+// a readable table goes to stderr.
+//
+// Usage: bench_dsp [--filter name] [--min-time ms] [--max-seconds s]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "opencv.hpp"
+#include "alloccount.h"
+
+using namespace cv;
+using namespace std;
+
+#define DEFAULT_MIN_TIME_MS 200
+#define MAX_ITERATIONS 100000
+#define SIGNAL_BPM 72
+#define LOW_BPM 42
+#define HIGH_BPM 240
+#define SEC_PER_MIN 60
+
+// Signal at every stage of the green channel pipeline, so each kernel sees the input it gets in RPPG
+struct Input {
+    double fps;
+    int seconds;
+    Mat1d s;      // raw RGB means, one row per frame
+    Mat1b jumps;  // rescan flags, once per second
+    Mat1d g;      // denoised and normalised green channel
+    Mat1d g_det;  // detrended green channel
+    Mat1d s_f;    // moving average, as estimateHeartrate sees it
+    Mat1d s_det;  // denoised, normalised and detrended RGB, as pcaComponent sees it
+    int low;
+    int high;
+};
+
+struct Result {
+    string kernel;
+    double fps;
+    int seconds;
+    int samples;
+    long iterations;
+    double nsPerOp;
+    double heapAllocsPerOp;
+    double heapBytesPerOp;
+    double matAllocsPerOp;
+    double matBytesPerOp;
+};
+
+static Input makeInput(double fps, int seconds) {
+
+    Input in;
+    in.fps = fps;
+    in.seconds = seconds;
+
+    const int rows = (int)(fps * seconds);
+    const double base[] = {140.0, 110.0, 90.0};
+    const double amplitude[] = {0.2, 0.6, 0.1};
+
+    RNG rng(0x5eed);
+    in.s.create(rows, 3);
+    in.jumps = Mat1b::zeros(rows, 1);
+    double offset = 0.0;
+    for (int i = 0; i < rows; i++) {
+        double time = i / fps;
+        double pulse = sin(2 * CV_PI * SIGNAL_BPM / SEC_PER_MIN * time);
+        // A rescan moves the box, which shows up as a step in the means
+        if (i > 0 && i % (int)fps == 0) {
+            in.jumps(i, 0) = 1;
+            offset = rng.uniform(-2.0, 2.0);
+        }
+        for (int c = 0; c < 3; c++) {
+            in.s(i, c) = base[c] + offset + 0.5 * time + amplitude[c] * pulse + rng.gaussian(0.3);
+        }
+    }
+
+    in.low = (int)(rows * LOW_BPM / SEC_PER_MIN / fps);
+    in.high = (int)(rows * HIGH_BPM / SEC_PER_MIN / fps) + 1;
+
+    denoise(in.s.col(1), in.jumps, in.g);
+    normalization(in.g, in.g);
+    detrend(in.g, in.g_det, fps);
+    movingAverage(in.g_det, in.s_f, 3, fmax(floor(fps / 6), 2));
+
+    Mat1d s_den;
+    denoise(in.s, in.jumps, s_den);
+    normalization(s_den, s_den);
+    detrend(s_den, in.s_det, fps);
+
+    return in;
+}
+
+// Same steps as RPPG::estimateHeartrate, without the averaging state
+static double estimateHeartrate(const Mat1d &s_f, double fps, int low, int high) {
+
+    Mat1d powerSpectrum;
+    timeToFrequency(s_f, powerSpectrum, true);
+
+    const int total = s_f.rows;
+    Mat bandMask = Mat::zeros(s_f.size(), CV_8U);
+    bandMask.rowRange(min(low, total), min(high, total) + 1).setTo(ONE);
+
+    double vmin, vmax;
+    Point pmin, pmax;
+    minMaxLoc(powerSpectrum, &vmin, &vmax, &pmin, &pmax, bandMask);
+    spectralQuality(powerSpectrum, min(low, total), min(high, total), pmax.y);
+
+    return pmax.y * fps / total * SEC_PER_MIN;
+}
+
+static Result run(const string &kernel, const Input &in, const function<void()> &op, double minTimeMs) {
+
+    // Warm up caches and OpenCV's lazy initialisation
+    op();
+
+    AllocCounts before = alloccount::snapshot();
+    auto start = chrono::steady_clock::now();
+    long iterations = 0;
+    double elapsed = 0.0;
+    do {
+        op();
+        iterations++;
+        elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < minTimeMs * 1e6 && iterations < MAX_ITERATIONS);
+    AllocCounts after = alloccount::snapshot();
+
+    Result r;
+    r.kernel = kernel;
+    r.fps = in.fps;
+    r.seconds = in.seconds;
+    r.samples = in.s.rows;
+    r.iterations = iterations;
+    r.nsPerOp = elapsed / iterations;
+    r.heapAllocsPerOp = (double)(after.heapAllocs - before.heapAllocs) / iterations;
+    r.heapBytesPerOp = (double)(after.heapBytes - before.heapBytes) / iterations;
+    r.matAllocsPerOp = (double)(after.matAllocs - before.matAllocs) / iterations;
+    r.matBytesPerOp = (double)(after.matBytes - before.matBytes) / iterations;
+    return r;
+}
+
+static void printJson(const vector<Result> &results, double minTimeMs) {
+    printf("{\n");
+    printf("  \"benchmark\": \"bench_dsp\",\n");
+    printf("  \"opencv\": \"%s\",\n", CV_VERSION);
+    printf("  \"min_time_ms\": %g,\n", minTimeMs);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("    {\"kernel\": \"%s\", \"fps\": %g, \"seconds\": %d, \"samples\": %d, \"iterations\": %ld, "
+               "\"ns_per_op\": %.1f, \"heap_allocs_per_op\": %.2f, \"heap_bytes_per_op\": %.0f, "
+               "\"mat_allocs_per_op\": %.2f, \"mat_bytes_per_op\": %.0f}%s\n",
+               r.kernel.c_str(), r.fps, r.seconds, r.samples, r.iterations,
+               r.nsPerOp, r.heapAllocsPerOp, r.heapBytesPerOp,
+               r.matAllocsPerOp, r.matBytesPerOp,
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+int main(int argc, char **argv) {
+
+    string filter;
+    double minTimeMs = DEFAULT_MIN_TIME_MS;
+    int maxSeconds = 60;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            minTimeMs = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-seconds") && i + 1 < argc) {
+            maxSeconds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter name] [--min-time ms] [--max-seconds s]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    alloccount::install();
+
+    const double rates[] = {30, 60};
+    const int lengths[] = {1, 2, 5, 10, 15, 30, 60};
+
+    vector<Result> results;
+    fprintf(stderr, "%-18s %4s %4s %7s %14s %10s %10s\n", "kernel", "fps", "sec", "samples", "ns/op", "heap/op", "mat/op");
+
+    for (double fps : rates) {
+        for (int seconds : lengths) {
+            if (seconds > maxSeconds) {
+                continue;
+            }
+
+            const Input in = makeInput(fps, seconds);
+            Mat out, pc, outPca;
+
+            const vector<pair<string, function<void()>>> kernels = {
+                {"normalization", [&]() { normalization(in.g_det, out); }},
+                {"denoise", [&]() { denoise(in.s.col(1), in.jumps, out); }},
+                {"detrend", [&]() { detrend(in.g, out, fps); }},
+                {"movingAverage", [&]() { movingAverage(in.g_det, out, 3, fmax(floor(fps / 6), 2)); }},
+                {"bandpass", [&]() { bandpass(in.g_det, out, in.low, in.high); }},
+                {"timeToFrequency", [&]() { timeToFrequency(in.s_f, out, true); }},
+                {"pcaComponent", [&]() { pcaComponent(in.s_det, outPca, pc, in.low, in.high); }},
+                {"estimateHeartrate", [&]() { estimateHeartrate(in.s_f, fps, in.low, in.high); }},
+            };
+
+            for (const auto &kernel : kernels) {
+                if (!filter.empty() && kernel.first.find(filter) == string::npos) {
+                    continue;
+                }
+                Result r = run(kernel.first, in, kernel.second, minTimeMs);
+                fprintf(stderr, "%-18s %4g %4d %7d %14.1f %10.2f %10.2f\n", r.kernel.c_str(), r.fps, r.seconds,
+                        r.samples, r.nsPerOp, r.heapAllocsPerOp, r.matAllocsPerOp);
+                results.push_back(r);
+            }
+        }
+    }
+
+    printJson(results, minTimeMs);
+    return 0;
+}
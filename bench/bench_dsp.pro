@@ -0,0 +1,40 @@
+# Microbenchmarks for the DSP kernels in opencv.cpp
+#   qmake bench_dsp.pro && make && ./bench_dsp > bench_dsp.json
+
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_dsp
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../alloccount.cpp \
+    ../opencv.cpp \
+    ../profiler.cpp \
+    bench_dsp.cpp
+
+HEADERS += \
+    ../alloccount.h \
+    ../opencv.hpp \
+    ../profiler.h
+
+win32 {
+    LIBS += -L$$(OPENCV_DIR)/lib -lopencv_world452
+    INCLUDEPATH += C:/opencv/build/include
+}
+
+unix:!macx {
+    INCLUDEPATH += /usr/local/include/opencv4
+    INCLUDEPATH += /usr/include/opencv4
+
+    LIBS += -lopencv_core -lopencv_highgui -lopencv_imgproc
+}
+
+macx {
+    INCLUDEPATH += /usr/local/Cellar/opencv/4.10.0_12/include/opencv4
+    LIBS += -L/usr/local/Cellar/opencv/4.10.0_12/lib -lopencv_core -lopencv_highgui -lopencv_imgproc
+}
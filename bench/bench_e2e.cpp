@@ -0,0 +1,389 @@
+// End-to-end benchmark of the face pipeline on a synthetic pulsing face.
+//
+// Frames go through the same grey conversion as MainWindow::processFrame and then
+// RPPG::processFrame, with capture timestamps from the generator's frame clock, so runs
+// are repeatable without a camera. The face box is injected unless --detect is given.
+// Results go to stdout as JSON; a summary goes to stderr. Build with CONFIG+=profiling
+// to add the latencies of the stages inside RPPG, or with CONFIG+=allocations to also add
+// their allocations per frame. --no-alloc then gates every stage of processFrame once the
+// buffers are full. Stages with their own code have a budget of zero; stages that call
+// OpenCV routines with their own scratch memory (detection, tracking, filtering and the
+// spectrum) may not allocate more than in the recorded run given by --alloc-baseline.
+//
+// Usage: bench_e2e [--seconds s] [--fps f] [--size WxH] [--bpm b] [--amplitude a] [--noise n]
+//                  [--motion px] [--flicker depth] [--occlusions per-minute] [--seed n]
+//                  [--detect] [--max-error bpm] [--no-alloc] [--alloc-baseline bench_e2e.json]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+#include "RPPG.hpp"
+#include "profiler.h"
+#include "syntheticface.h"
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+#include "alloccount.h"
+#endif
+
+using namespace cv;
+using namespace std;
+
+#define DEFAULT_SECONDS 60
+#define DETECTOR_TIMEOUT_MS 10000
+// Signal buffers stop growing once the longest window is full
+#define STEADY_STATE_SECONDS (DEFAULT_RESP_SIGNAL_SIZE + 1)
+#define ALLOC_BASELINE_SLACK 0.05 // relative headroom over a recorded baseline
+#define ALLOC_BASELINE_FLOOR 0.02 // allocations per frame always tolerated over a baseline
+
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+// Steady-state allocations per processFrame call for each stage, heap and Mat together.
+// NO_BUDGET stages must match --alloc-baseline. The last entry is processFrame code outside any stage.
+#define NO_BUDGET -1.0
+static const double STAGE_ALLOC_BUDGET[] = {
+    0.0,        // ingest, not part of processFrame
+    0.0,        // equalize, not part of processFrame
+    NO_BUDGET,  // detect: cascade or network
+    NO_BUDGET,  // track: optical flow pyramids and the rigid transform
+    0.0,        // mask, redrawn in place
+    0.0,        // mean
+    0.0,        // buffer, reserved for the longest window
+    NO_BUDGET,  // extract: denoise, detrend, blur and PCA temporaries
+    NO_BUDGET,  // estimate: dft
+    0.0,        // draw, not part of processFrame
+    0.0,        // present, not part of processFrame
+    NO_BUDGET,  // outside any stage: overlay, respiration and beats
+};
+
+static_assert(sizeof(STAGE_ALLOC_BUDGET) / sizeof(STAGE_ALLOC_BUDGET[0]) == (int)Stage::Count + 1, "Allocation budgets out of date");
+
+static const char *allocStageName(int i) {
+    return i < (int)Stage::Count ? stageName((Stage)i) : "other";
+}
+
+// Per-frame steady-state allocations of each stage from an earlier run's report, -1 if absent
+static bool readAllocBaseline(const char *path, double baseline[(int)Stage::Count + 1]) {
+    ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    stringstream text;
+    text << file.rdbuf();
+    string json = text.str();
+    size_t section = json.find("\"steady_stages\"");
+    if (section == string::npos) {
+        return false;
+    }
+    for (int i = 0; i <= (int)Stage::Count; i++) {
+        baseline[i] = -1.0;
+        string key = string("\"") + allocStageName(i) + "\": {\"allocs\": ";
+        size_t at = json.find(key, section);
+        if (at != string::npos) {
+            baseline[i] = atof(json.c_str() + at + key.size());
+        }
+    }
+    return true;
+}
+#endif
+
+struct LatencyStats {
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double total = 0.0;
+};
+
+// Percentiles in microseconds
+static LatencyStats stats(vector<double> samples) {
+    LatencyStats r;
+    if (samples.empty()) {
+        return r;
+    }
+    sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[min(samples.size() - 1, (size_t)(q * samples.size()))]; };
+    r.p50 = at(0.50);
+    r.p95 = at(0.95);
+    r.p99 = at(0.99);
+    r.max = samples.back();
+    for (double v : samples) {
+        r.total += v;
+    }
+    return r;
+}
+
+static void printStats(const char *name, const LatencyStats &s, bool last) {
+    printf("    \"%s\": {\"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}%s\n",
+           name, s.p50, s.p95, s.p99, s.max, last ? "" : ",");
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--seconds s] [--fps f] [--size WxH] [--bpm b] [--amplitude a] [--noise n]\n"
+                    "       [--motion px] [--flicker depth] [--occlusions per-minute] [--seed n]\n"
+                    "       [--detect] [--max-error bpm] [--no-alloc] [--alloc-baseline bench_e2e.json]\n", name);
+}
+
+int main(int argc, char **argv) {
+
+    SyntheticFaceSettings settings;
+    double seconds = DEFAULT_SECONDS;
+    bool detect = false;
+    double maxError = -1.0;
+    bool noAlloc = false;
+    const char *allocBaseline = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--detect")) {
+            detect = true;
+            continue;
+        }
+        if (!strcmp(arg, "--no-alloc")) {
+            noAlloc = true;
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (!strcmp(arg, "--seconds")) seconds = atof(value);
+        else if (!strcmp(arg, "--fps")) settings.fps = atof(value);
+        else if (!strcmp(arg, "--size")) sscanf(value, "%dx%d", &settings.size.width, &settings.size.height);
+        else if (!strcmp(arg, "--bpm")) settings.bpm = atof(value);
+        else if (!strcmp(arg, "--amplitude")) settings.amplitude = atof(value);
+        else if (!strcmp(arg, "--noise")) settings.noise = atof(value);
+        else if (!strcmp(arg, "--motion")) settings.motion = atof(value);
+        else if (!strcmp(arg, "--flicker")) settings.flicker = atof(value);
+        else if (!strcmp(arg, "--occlusions")) settings.occlusions = atof(value);
+        else if (!strcmp(arg, "--seed")) settings.seed = (unsigned)atoi(value);
+        else if (!strcmp(arg, "--max-error")) maxError = atof(value);
+        else if (!strcmp(arg, "--alloc-baseline")) allocBaseline = value;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+    alloccount::install();
+    double budget[(int)Stage::Count + 1];
+    copy(STAGE_ALLOC_BUDGET, STAGE_ALLOC_BUDGET + (int)Stage::Count + 1, budget);
+    if (allocBaseline) {
+        double baseline[(int)Stage::Count + 1];
+        if (!readAllocBaseline(allocBaseline, baseline)) {
+            fprintf(stderr, "%s has no steady_stages allocations\n", allocBaseline);
+            return 1;
+        }
+        for (int i = 0; i <= (int)Stage::Count; i++) {
+            if (budget[i] == NO_BUDGET) {
+                // A stage missing from the baseline is taken as not allocating
+                budget[i] = max(baseline[i], 0.0) * (1 + ALLOC_BASELINE_SLACK) + ALLOC_BASELINE_FLOOR;
+            }
+        }
+    } else if (noAlloc) {
+        fprintf(stderr, "--no-alloc needs --alloc-baseline for the stages without a fixed budget;\n"
+                        "record one with a run of the same settings without --no-alloc\n");
+        return 1;
+    }
+#else
+    if (noAlloc || allocBaseline) {
+        fprintf(stderr, "--no-alloc needs a build with CONFIG+=allocations\n");
+        return 1;
+    }
+#endif
+    if (noAlloc && seconds <= STEADY_STATE_SECONDS) {
+        fprintf(stderr, "--no-alloc needs more than %d seconds\n", STEADY_STATE_SECONDS);
+        return 1;
+    }
+
+    RPPG rppg;
+    if (!rppg.load(HAAR_CLASSIFIER_PATH, DNN_PROTO_PATH, DNN_MODEL_PATH)) {
+        fprintf(stderr, "Could not load RPPG settings\n");
+        return 1;
+    }
+    if (detect) {
+        auto start = chrono::steady_clock::now();
+        while (!rppg.detectorReady()) {
+            if (chrono::steady_clock::now() - start > chrono::milliseconds(DETECTOR_TIMEOUT_MS)) {
+                fprintf(stderr, "Face detector did not load\n");
+                return 1;
+            }
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+
+    SyntheticFace face(settings);
+    const int frames = (int)(seconds * settings.fps);
+
+    // Estimates are scored once the full heart rate window is available
+    const double scoreAfter = DEFAULT_MIN_SIGNAL_SIZE;
+
+    vector<double> convertTimes, processTimes;
+    convertTimes.reserve(frames);
+    processTimes.reserve(frames);
+    Mat frameRGB, frameGray;
+    double bpm = 0.0;
+    double errorSum = 0.0, errorMax = 0.0;
+    int scored = 0;
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+    // processFrame allocations once the signal buffers are full, in total and per stage
+    AllocCounts steadyAllocs;
+    uint64_t steadyStageAllocs[(int)Stage::Count + 1] = {};
+    AllocCounts stageBefore[(int)Stage::Count + 1];
+    int steadyFrames = 0, allocatingFrames = 0;
+#endif
+
+    for (int i = 0; i < frames; i++) {
+
+        face.render(i, frameRGB);
+        if (!detect) {
+            rppg.setFaceBox(face.faceBox());
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        // Same conversion as MainWindow::processFrame
+        cvtColor(frameRGB, frameGray, COLOR_BGR2GRAY);
+        equalizeHist(frameGray, frameGray);
+        auto t1 = chrono::steady_clock::now();
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+        AllocCounts before = alloccount::snapshot();
+        for (int s = 0; s <= (int)Stage::Count; s++) {
+            stageBefore[s] = alloccount::snapshot((Stage)s);
+        }
+#endif
+        bpm = rppg.processFrame(frameRGB, frameGray, face.timestamp(i));
+        auto t2 = chrono::steady_clock::now();
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+        if (i / settings.fps >= STEADY_STATE_SECONDS) {
+            AllocCounts after = alloccount::snapshot();
+            uint64_t heap = after.heapAllocs - before.heapAllocs;
+            uint64_t mat = after.matAllocs - before.matAllocs;
+            steadyAllocs.heapAllocs += heap;
+            steadyAllocs.heapBytes += after.heapBytes - before.heapBytes;
+            steadyAllocs.matAllocs += mat;
+            steadyAllocs.matBytes += after.matBytes - before.matBytes;
+            steadyFrames++;
+            if (heap + mat > 0) {
+                allocatingFrames++;
+            }
+            for (int s = 0; s <= (int)Stage::Count; s++) {
+                AllocCounts stageAfter = alloccount::snapshot((Stage)s);
+                steadyStageAllocs[s] += stageAfter.heapAllocs + stageAfter.matAllocs
+                                        - stageBefore[s].heapAllocs - stageBefore[s].matAllocs;
+            }
+        }
+#endif
+
+        convertTimes.push_back(chrono::duration<double, micro>(t1 - t0).count());
+        processTimes.push_back(chrono::duration<double, micro>(t2 - t1).count());
+
+        if (i / settings.fps >= scoreAfter && bpm > 0) {
+            double error = fabs(bpm - settings.bpm);
+            errorSum += error;
+            errorMax = max(errorMax, error);
+            scored++;
+        }
+    }
+
+    LatencyStats convert = stats(convertTimes);
+    LatencyStats process = stats(processTimes);
+    double busy = (convert.total + process.total) * 1e-6;
+    double framesPerSecond = busy > 0 ? frames / busy : 0.0;
+    double meanError = scored > 0 ? errorSum / scored : -1.0;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"bench_e2e\",\n");
+    printf("  \"settings\": {\"seconds\": %g, \"fps\": %g, \"width\": %d, \"height\": %d, \"bpm\": %g, "
+           "\"amplitude\": %g, \"noise\": %g, \"motion\": %g, \"flicker\": %g, \"occlusions\": %g, "
+           "\"seed\": %u, \"detect\": %s},\n",
+           seconds, settings.fps, settings.size.width, settings.size.height, settings.bpm,
+           settings.amplitude, settings.noise, settings.motion, settings.flicker, settings.occlusions,
+           settings.seed, detect ? "true" : "false");
+    printf("  \"frames\": %d,\n", frames);
+    printf("  \"frames_per_s\": %.1f,\n", framesPerSecond);
+    // Whole steps, plus the stages inside RPPG when built with profiling
+    vector<pair<string, LatencyStats>> latencies = {{"convert", convert}, {"process", process}};
+#ifdef HEARTBEAT_PROFILING
+    for (int i = 0; i < (int)Stage::Count; i++) {
+        StageStats stage = Profiler::instance().stats((Stage)i);
+        if (stage.count > 0) {
+            LatencyStats l;
+            l.p50 = stage.p50;
+            l.p95 = stage.p95;
+            l.p99 = stage.p99;
+            l.max = stage.max;
+            latencies.push_back({stageName((Stage)i), l});
+        }
+    }
+#endif
+    printf("  \"latency\": {\n");
+    for (size_t i = 0; i < latencies.size(); i++) {
+        printStats(latencies[i].first.c_str(), latencies[i].second, i + 1 == latencies.size());
+    }
+    printf("  },\n");
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+    // Per frame over the whole run, then per frame of steady-state processFrame
+    printf("  \"allocations\": {\n");
+    for (int i = 0; i <= (int)Stage::Count; i++) {
+        AllocCounts c = alloccount::snapshot((Stage)i);
+        if (c.heapAllocs == 0 && c.matAllocs == 0) {
+            continue;
+        }
+        printf("    \"%s\": {\"heap_allocs\": %.2f, \"heap_bytes\": %.0f, \"mat_allocs\": %.2f, \"mat_bytes\": %.0f},\n",
+               i < (int)Stage::Count ? stageName((Stage)i) : "other",
+               (double)c.heapAllocs / frames, (double)c.heapBytes / frames,
+               (double)c.matAllocs / frames, (double)c.matBytes / frames);
+    }
+    int n = max(1, steadyFrames);
+    printf("    \"steady_process\": {\"heap_allocs\": %.2f, \"heap_bytes\": %.0f, \"mat_allocs\": %.2f, \"mat_bytes\": %.0f, "
+           "\"frames\": %d, \"allocating_frames\": %d}\n",
+           (double)steadyAllocs.heapAllocs / n, (double)steadyAllocs.heapBytes / n,
+           (double)steadyAllocs.matAllocs / n, (double)steadyAllocs.matBytes / n,
+           steadyFrames, allocatingFrames);
+    printf("  },\n");
+    // Heap and Mat allocations per steady-state frame and the budget they are gated against,
+    // -1 when the stage has none; read back by --alloc-baseline
+    printf("  \"steady_stages\": {\n");
+    string overBudget;
+    for (int i = 0; i <= (int)Stage::Count; i++) {
+        double allocs = (double)steadyStageAllocs[i] / n;
+        printf("    \"%s\": {\"allocs\": %.3f, \"budget\": %.3f}%s\n",
+               allocStageName(i), allocs, budget[i], i == (int)Stage::Count ? "" : ",");
+        if (budget[i] != NO_BUDGET && allocs > budget[i]) {
+            char line[128];
+            snprintf(line, sizeof(line), "  %s: %.3f allocations per frame, budget %.3f\n", allocStageName(i), allocs, budget[i]);
+            overBudget += line;
+        }
+    }
+    printf("  },\n");
+#endif
+    printf("  \"bpm\": {\"final\": %.1f, \"mean_abs_error\": %.2f, \"max_abs_error\": %.2f, "
+           "\"scored_frames\": %d, \"time_to_first_s\": %.2f}\n",
+           bpm, meanError, errorMax, scored, rppg.getTimeToFirstBpm());
+    printf("}\n");
+
+    fprintf(stderr, "%d frames, %.1f frames/s, process p50 %.0f us p99 %.0f us, final %.1f bpm (truth %g), MAE %.2f\n",
+            frames, framesPerSecond, process.p50, process.p99, bpm, settings.bpm, meanError);
+
+    if (maxError >= 0 && (scored == 0 || meanError > maxError)) {
+        fprintf(stderr, "BPM error above %g\n", maxError);
+        return 1;
+    }
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+    if (noAlloc && !overBudget.empty()) {
+        fprintf(stderr, "Stages over their allocation budget in %d steady-state frames:\n%s",
+                steadyFrames, overBudget.c_str());
+        return 1;
+    }
+#endif
+    return 0;
+}
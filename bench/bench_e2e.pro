@@ -0,0 +1,68 @@
+# End-to-end benchmark of RPPG on a synthetic pulsing face
+#   qmake bench_e2e.pro && make && ./bench_e2e > bench_e2e.json
+
+QT = core multimedia
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_e2e
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../RPPG.cpp \
+    ../beatdetector.cpp \
+    ../eventlog.cpp \
+    ../opencv.cpp \
+    ../profiler.cpp \
+    ../roitrace.cpp \
+    bench_e2e.cpp \
+    syntheticface.cpp
+
+HEADERS += \
+    ../RPPG.hpp \
+    ../beatdetector.h \
+    ../eventlog.h \
+    ../opencv.hpp \
+    ../overlay.h \
+    ../profiler.h \
+    ../roitrace.h \
+    ../trace.h \
+    syntheticface.h
+
+# Adds per-stage allocation counts and enables --no-alloc: qmake CONFIG+=allocations
+allocations {
+    CONFIG += profiling
+    DEFINES += HEARTBEAT_ALLOC_ACCOUNTING
+    SOURCES += ../alloccount.cpp
+    HEADERS += ../alloccount.h
+}
+
+# Adds per-stage latencies to the report: qmake CONFIG+=profiling
+profiling {
+    DEFINES += HEARTBEAT_PROFILING
+    SOURCES += ../trace.cpp
+}
+
+# Only the Haar cascade, the DNN model is not needed here
+RESOURCES += \
+    bench_e2e.qrc
+
+win32 {
+    LIBS += -L$$(OPENCV_DIR)/lib -lopencv_world452
+    INCLUDEPATH += C:/opencv/build/include
+}
+
+unix:!macx {
+    INCLUDEPATH += /usr/local/include/opencv4
+    INCLUDEPATH += /usr/include/opencv4
+
+    LIBS += -lopencv_core -lopencv_dnn -lopencv_highgui -lopencv_imgcodecs -lopencv_imgproc -lopencv_objdetect -lopencv_video -lopencv_videoio
+}
+
+macx {
+    INCLUDEPATH += /usr/local/Cellar/opencv/4.10.0_12/include/opencv4
+    LIBS += -L/usr/local/Cellar/opencv/4.10.0_12/lib -lopencv_core -lopencv_dnn -lopencv_highgui -lopencv_imgcodecs -lopencv_imgproc -lopencv_objdetect -lopencv_video -lopencv_videoio
+}
@@ -0,0 +1,85 @@
+// Replays recorded ROI traces (HEARTBEAT_RECORD) through the heart rate estimator.
+//
+// No video and no vision stages are involved, so sessions can be re-scored quickly after a
+// change to the signal processing. Readings go to stdout as CSV, one line per second of
+// trace time; a summary with the replay speed goes to stderr. By default the estimator runs
+// once per reading, --every-sample runs it on every sample like the live app.
+//
+// Usage: replay [--interval ms] [--every-sample] trace...
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "RPPG.hpp"
+#include "roireplay.h"
+
+using namespace std;
+
+#define REPORT_INTERVAL_MS 1000
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--interval ms] [--every-sample] trace...\n", name);
+}
+
+int main(int argc, char **argv) {
+
+    int intervalMs = (int)(1000 / DEFAULT_SAMPLING_FREQUENCY);
+    vector<const char *> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+            intervalMs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--every-sample")) {
+            intervalMs = 0;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("trace,time_s,bpm,confidence,quality_db\n");
+
+    long long samples = 0;
+    double seconds = 0.0;
+    int failed = 0;
+
+    for (const char *path : paths) {
+
+        RoiReplay replay;
+        if (!replay.open(path)) {
+            fprintf(stderr, "%s: not a readable ROI trace of this format version\n", path);
+            failed++;
+            continue;
+        }
+
+        // No detector models, replay never looks at a frame
+        RPPG rppg;
+        rppg.load("", "", "");
+
+        int nextReport = 0;
+        auto start = chrono::steady_clock::now();
+        replay.run(rppg, intervalMs, [&](int time) {
+            if (time >= nextReport) {
+                nextReport = time + REPORT_INTERVAL_MS;
+                if (rppg.getBpm() > 0) {
+                    printf("%s,%.3f,%.1f,%.2f,%.2f\n", path, time / 1000.0,
+                           rppg.getBpm(), rppg.getConfidence(), rppg.getQuality());
+                }
+            }
+        });
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        samples += replay.sampleCount();
+    }
+
+    fprintf(stderr, "%lld samples from %d traces in %.2f s, %.0f samples/s\n",
+            samples, (int)paths.size() - failed, seconds, seconds > 0 ? samples / seconds : 0.0);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+# Replays recorded ROI traces through the heart rate estimator
+#   qmake replay.pro && make && ./replay session.hbrt > readings.csv
+
+QT = core multimedia
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = replay
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../RPPG.cpp \
+    ../beatdetector.cpp \
+    ../eventlog.cpp \
+    ../opencv.cpp \
+    ../profiler.cpp \
+    ../roireplay.cpp \
+    ../roitrace.cpp \
+    replay.cpp
+
+HEADERS += \
+    ../RPPG.hpp \
+    ../beatdetector.h \
+    ../eventlog.h \
+    ../opencv.hpp \
+    ../overlay.h \
+    ../profiler.h \
+    ../roireplay.h \
+    ../roitrace.h \
+    ../trace.h
+
+win32 {
+    LIBS += -L$$(OPENCV_DIR)/lib -lopencv_world452
+    INCLUDEPATH += C:/opencv/build/include
+}
+
+unix:!macx {
+    INCLUDEPATH += /usr/local/include/opencv4
+    INCLUDEPATH += /usr/include/opencv4
+
+    LIBS += -lopencv_core -lopencv_dnn -lopencv_highgui -lopencv_imgcodecs -lopencv_imgproc -lopencv_objdetect -lopencv_video -lopencv_videoio
+}
+
+macx {
+    INCLUDEPATH += /usr/local/Cellar/opencv/4.10.0_12/include/opencv4
+    LIBS += -L/usr/local/Cellar/opencv/4.10.0_12/lib -lopencv_core -lopencv_dnn -lopencv_highgui -lopencv_imgcodecs -lopencv_imgproc -lopencv_objdetect -lopencv_video -lopencv_videoio
+}
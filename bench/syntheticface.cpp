@@ -0,0 +1,142 @@
+#include "syntheticface.h"
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+#define SEC_PER_MIN 60
+#define SWAY_X_HZ 0.23
+#define SWAY_Y_HZ 0.17
+#define TEXTURE_SIGMA 6.0
+
+// Relative blood volume pulse strength in R, G and B; green is strongest
+static const double PULSE_RGB[] = {0.43, 1.0, 0.69};
+
+SyntheticFace::SyntheticFace(const SyntheticFaceSettings &settings)
+    : settings(settings)
+    , rng(settings.seed)
+{
+    const Size size = settings.size;
+    const int cx = size.width / 2;
+    const int cy = size.height / 2;
+    const int fw = (int)(0.56 * size.height);
+    const int fh = (int)(0.72 * size.height);
+    faceRect = Rect(cx - fw / 2, cy - fh / 2, fw, fh);
+    skinColor = Scalar(224, 172, 140);
+
+    // Background: vertical gradient
+    Mat3b scene(size);
+    for (int y = 0; y < size.height; y++) {
+        double v = 70 + 50.0 * y / size.height;
+        scene.row(y).setTo(Scalar(v * 0.8, v * 0.9, v));
+    }
+
+    // Hair behind the forehead
+    ellipse(scene, Point(cx, cy - fh / 8), Size(fw * 11 / 20, fh / 2), 0, 180, 360, Scalar(60, 40, 30), FILLED, LINE_AA);
+
+    // Skin
+    Mat1b skin = Mat1b::zeros(size);
+    ellipse(scene, Point(cx, cy), Size(fw / 2, fh / 2), 0, 0, 360, skinColor, FILLED, LINE_AA);
+    ellipse(skin, Point(cx, cy), Size(fw / 2, fh / 2), 0, 0, 360, Scalar(255), FILLED);
+
+    // Fixed skin texture so the tracker finds corners
+    Mat1f texture(size);
+    RNG textureRng(settings.seed ^ 0x7e57);
+    textureRng.fill(texture, RNG::NORMAL, 0.0, TEXTURE_SIGMA);
+    GaussianBlur(texture, texture, Size(5, 5), 0);
+
+    // Features, also cut out of the skin mask
+    const Scalar dark(50, 35, 30);
+    for (int side = -1; side <= 1; side += 2) {
+        Point eye(cx + side * fw / 5, cy - fh / 12);
+        ellipse(scene, eye, Size(fw / 11, fh / 28), 0, 0, 360, Scalar(235, 235, 230), FILLED, LINE_AA);
+        circle(scene, eye, fw / 30, dark, FILLED, LINE_AA);
+        ellipse(skin, eye, Size(fw / 9, fh / 20), 0, 0, 360, Scalar(0), FILLED);
+
+        Point brow0(cx + side * fw / 10, cy - fh / 6);
+        Point brow1(cx + side * (fw * 3 / 10), cy - fh / 6 + fh / 60);
+        line(scene, brow0, brow1, dark, max(fh / 40, 2), LINE_AA);
+        line(skin, brow0, brow1, Scalar(0), max(fh / 20, 4));
+
+        ellipse(scene, Point(cx + side * fw / 22, cy + fh / 8), Size(fw / 40, fh / 80), 0, 0, 360, dark, FILLED, LINE_AA);
+    }
+    // Nose shadow
+    line(scene, Point(cx - fw / 30, cy - fh / 20), Point(cx - fw / 24, cy + fh / 10), skinColor * 0.8, max(fw / 40, 2), LINE_AA);
+    // Mouth
+    ellipse(scene, Point(cx, cy + fh / 4), Size(fw / 6, fh / 25), 0, 0, 360, Scalar(150, 60, 60), FILLED, LINE_AA);
+    ellipse(skin, Point(cx, cy + fh / 4), Size(fw / 5, fh / 16), 0, 0, 360, Scalar(0), FILLED);
+
+    scene.convertTo(face, CV_32F);
+    Mat textureRgb;
+    Mat planes[] = {texture, texture, texture};
+    merge(planes, 3, textureRgb);
+    add(face, textureRgb, face, skin);
+
+    // Pulse gain per channel on the skin only
+    Mat1f skinF;
+    skin.convertTo(skinF, CV_32F, 1.0 / 255);
+    Mat gainPlanes[3];
+    for (int c = 0; c < 3; c++) {
+        gainPlanes[c] = skinF * (PULSE_RGB[c] * settings.amplitude);
+    }
+    merge(gainPlanes, 3, pulseGain);
+}
+
+// Smooth pulse with a dicrotic notch shaped second harmonic, peak about 1
+double SyntheticFace::pulse(double time) const {
+    double phase = 2 * CV_PI * settings.bpm / SEC_PER_MIN * time;
+    return (sin(phase) + 0.3 * sin(2 * phase + 0.8)) / 1.2;
+}
+
+bool SyntheticFace::occludedAt(double time) const {
+    if (settings.occlusions <= 0) {
+        return false;
+    }
+    double period = SEC_PER_MIN / settings.occlusions;
+    double offset = fmod(time, period) - period / 2;
+    return offset >= 0 && offset < settings.occlusionSeconds;
+}
+
+int64_t SyntheticFace::timestamp(int index) const {
+    return llround(index * 1000.0 / settings.fps);
+}
+
+void SyntheticFace::render(int index, Mat &frameRGB) {
+
+    const double time = index / settings.fps;
+
+    // Head sway
+    double dx = settings.motion * sin(2 * CV_PI * SWAY_X_HZ * time);
+    double dy = 0.5 * settings.motion * sin(2 * CV_PI * SWAY_Y_HZ * time);
+    if (settings.motion > 0) {
+        Matx23d shift(1, 0, dx, 0, 1, dy);
+        warpAffine(face, work, shift, face.size(), INTER_LINEAR, BORDER_REPLICATE);
+        warpAffine(pulseGain, gain, shift, face.size(), INTER_LINEAR, BORDER_CONSTANT);
+    } else {
+        face.copyTo(work);
+        pulseGain.copyTo(gain);
+    }
+    box = faceRect + Point((int)lround(dx), (int)lround(dy));
+
+    // Pulse on skin
+    scaleAdd(gain, pulse(time), work, work);
+
+    // Hand over the lower face
+    occludedNow = occludedAt(time);
+    if (occludedNow) {
+        Rect hand(box.x - box.width / 10, box.y + box.height * 9 / 20, box.width * 7 / 10, box.height * 7 / 20);
+        rectangle(work, hand, skinColor * 1.05, FILLED);
+    }
+
+    // Sensor noise
+    if (settings.noise > 0) {
+        noise.create(work.size(), work.type());
+        rng.fill(noise, RNG::NORMAL, 0.0, settings.noise);
+        work += noise;
+    }
+
+    // Illumination flicker scales the whole exposure
+    double exposure = 1.0 + settings.flicker * sin(2 * CV_PI * settings.flickerHz * time);
+    work.convertTo(frameRGB, CV_8U, exposure);
+}
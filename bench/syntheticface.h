@@ -0,0 +1,65 @@
+#ifndef SYNTHETICFACE_H
+#define SYNTHETICFACE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <opencv2/core.hpp>
+
+struct SyntheticFaceSettings {
+    cv::Size size = cv::Size(640, 480);
+    double fps = 30.0;
+    double bpm = 72.0;
+    double amplitude = 1.0;         // peak pulse change of the green channel on skin, grey levels
+    double noise = 2.0;             // sensor noise standard deviation, grey levels
+    double motion = 0.0;            // head sway amplitude, pixels
+    double flicker = 0.0;           // illumination flicker depth, 0.02 is 2 %
+    double flickerHz = 10.0;        // mains flicker as aliased by the camera
+    double occlusions = 0.0;        // hand over face events per minute
+    double occlusionSeconds = 1.0;
+    unsigned seed = 1;
+};
+
+// Cartoon face whose skin pulses at a known rate, rendered as RGB888 frames.
+// The face is drawn with the dark eye, brow and mouth regions the frontal Haar cascade keys on;
+// faceBox gives its true bounds for detector-free runs.
+class SyntheticFace
+{
+public:
+    explicit SyntheticFace(const SyntheticFaceSettings &settings);
+
+    // Render frame index into frameRGB, which is reused between calls
+    void render(int index, cv::Mat &frameRGB);
+
+    // Capture time of frame index in milliseconds
+    int64_t timestamp(int index) const;
+
+    // Face bounds and occlusion state of the last rendered frame
+    cv::Rect faceBox() const { return box; }
+    bool occluded() const { return occludedNow; }
+
+    const SyntheticFaceSettings &getSettings() const { return settings; }
+
+private:
+    double pulse(double time) const;
+    bool occludedAt(double time) const;
+
+    SyntheticFaceSettings settings;
+
+    // Static scene, rendered once
+    cv::Mat face;      // CV_32FC3
+    cv::Mat pulseGain; // CV_32FC3, per channel pulse amplitude on skin, zero elsewhere
+    cv::Rect faceRect;
+    cv::Scalar skinColor;
+
+    // Per frame scratch
+    cv::Mat work;
+    cv::Mat gain;
+    cv::Mat noise;
+    cv::RNG rng;
+
+    cv::Rect box;
+    bool occludedNow = false;
+};
+
+#endif // SYNTHETICFACE_H
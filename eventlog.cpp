@@ -0,0 +1,136 @@
+#include "eventlog.h"
+#include <chrono>
+#include <QDebug>
+
+#define DRAIN_INTERVAL_MS 50
+
+struct EventInfo {
+    const char *format; // printf format taking the argument as long long
+    int intervalMs;     // minimum time between two records of the event
+};
+
+static const EventInfo EVENTS[] = {
+    {"Corner %lld rejected by the tracking check", 1000},
+    {"Tracking failed, %lld corners left", 0},
+    {"Input grayscale frame is empty", 1000},
+};
+
+static_assert(sizeof(EVENTS) / sizeof(EVENTS[0]) == (int)LogEvent::Count, "Event table out of date");
+
+static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+EventLog &EventLog::instance() {
+    static EventLog log;
+    return log;
+}
+
+EventLog::EventLog()
+    : origin(now())
+{
+    // Slot i is free for the write at position i
+    for (int i = 0; i < RING_SIZE; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < (int)LogEvent::Count; i++) {
+        nextAllowed[i].store(0, std::memory_order_relaxed);
+        suppressed[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+EventLog::~EventLog() {
+    stop();
+}
+
+void EventLog::start() {
+    if (drainThread.joinable()) {
+        return;
+    }
+    running.store(true, std::memory_order_relaxed);
+    drainThread = std::thread(&EventLog::run, this);
+}
+
+void EventLog::stop() {
+    if (!drainThread.joinable()) {
+        return;
+    }
+    running.store(false, std::memory_order_relaxed);
+    drainThread.join();
+}
+
+void EventLog::log(LogEvent event, int64_t arg) {
+
+    int code = (int)event;
+    uint64_t time = now();
+
+    // One record per interval, the rest are counted
+    uint64_t allowed = nextAllowed[code].load(std::memory_order_relaxed);
+    if (time < allowed || !nextAllowed[code].compare_exchange_strong(
+            allowed, time + EVENTS[code].intervalMs * 1000000ULL, std::memory_order_relaxed)) {
+        suppressed[code].fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Claim a slot; a slot still holding an unprinted record means the ring is full
+    uint64_t position = head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &ring[position & (RING_SIZE - 1)];
+        int64_t diff = (int64_t)(slot->sequence.load(std::memory_order_acquire) - position);
+        if (diff == 0) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time = time;
+    slot->arg = arg;
+    slot->suppressed = suppressed[code].exchange(0, std::memory_order_relaxed);
+    slot->event = event;
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void EventLog::run() {
+    while (running.load(std::memory_order_relaxed)) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_INTERVAL_MS));
+    }
+    drain();
+}
+
+void EventLog::drain() {
+    char message[256];
+    for (;;) {
+        Slot &slot = ring[tail & (RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+            break;
+        }
+        uint64_t time = slot.time;
+        long long arg = slot.arg;
+        uint32_t repeats = slot.suppressed;
+        const EventInfo &info = EVENTS[(int)slot.event];
+        slot.sequence.store(tail + RING_SIZE, std::memory_order_release);
+        tail++;
+
+        int length = snprintf(message, sizeof(message), "[%10.1f ms] ", (time - origin) / 1e6);
+        length += snprintf(message + length, sizeof(message) - length, info.format, arg);
+        if (repeats > 0) {
+            snprintf(message + length, sizeof(message) - length, " (%u more suppressed)", repeats);
+        }
+        qDebug().noquote() << message;
+    }
+
+    uint64_t drops = dropped.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+        qDebug() << "Event log full," << drops - reportedDrops << "records dropped";
+        reportedDrops = drops;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Log of pipeline events that is cheap enough for the frame path.
+// Callers write a fixed-size binary record (event code, argument, time) into a lock-free
+// ring; a background thread formats and prints them. Each code has a minimum interval,
+// repeats within it are only counted and reported with the next record that gets through.
+// When the ring is full, records are dropped rather than waiting.
+//
+// main() starts the drain thread before the first frame and stops it while the
+// QApplication still exists; records logged before start() wait in the ring.
+
+// Messages and intervals live in the table in eventlog.cpp
+enum class LogEvent : uint16_t {
+    CornerRejected,     // arg: corner index
+    TrackingLost,       // arg: corners left
+    EmptyGrayFrame,
+    Count
+};
+
+class EventLog
+{
+public:
+    static EventLog &instance();
+
+    void start();
+    // Prints what is left in the ring and joins the drain thread
+    void stop();
+
+    // Never blocks and never allocates
+    void log(LogEvent event, int64_t arg = 0);
+
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    ~EventLog();
+
+private:
+    EventLog();
+    void run();
+    void drain();
+
+    static constexpr int RING_SIZE = 1024; // power of two
+
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        uint64_t time;
+        int64_t arg;
+        uint32_t suppressed;
+        LogEvent event;
+    };
+
+    Slot ring[RING_SIZE];
+    std::atomic<uint64_t> head{0};
+    uint64_t tail = 0; // drain thread only
+    uint64_t reportedDrops = 0;
+    uint64_t origin;
+
+    std::atomic<uint64_t> nextAllowed[(int)LogEvent::Count];
+    std::atomic<uint32_t> suppressed[(int)LogEvent::Count];
+    std::atomic<uint64_t> dropped{0};
+
+    std::atomic<bool> running{false};
+    std::thread drainThread;
+};
+
+#define LOG_EVENT(...) EventLog::instance().log(__VA_ARGS__)
+
+#endif // EVENTLOG_H
@@ -1,10 +1,12 @@
 #include "frames.h"
+#include "profiler.h"
 
 Frames::Frames( QObject * parent )
     :	QVideoSink( parent )
     ,	m_cam( nullptr )
 {
-    connect( this, &QVideoSink::videoFrameChanged, this, &Frames::newFrame );
+    // Frames are taken on the thread that delivers them, so a slow consumer never queues more than one
+    connect( this, &QVideoSink::videoFrameChanged, this, &Frames::newFrame, Qt::DirectConnection );
 }
 
 Frames::~Frames()
@@ -15,17 +17,57 @@ Frames::~Frames()
 void
 Frames::newFrame( const QVideoFrame & frame )
 {
+    quint64 captured = ScopedStageTimer::now();
+
     if(!m_running)
+    {
+        Profiler::instance().countDrop(Drop::Stopped);
         return;
+    }
 
-    QVideoFrame f = frame;
-    f.map( QVideoFrame::ReadOnly );
+    if( !frame.isValid() )
+    {
+        Profiler::instance().countDrop(Drop::Invalid);
+        return;
+    }
 
-    if( f.isValid() )
+    bool notify;
     {
-        f.unmap();
-        emit frameCaptured(f);
+        QMutexLocker lock(&m_mailboxMutex);
+        if (m_mailboxFull)
+            Profiler::instance().countDrop(Drop::Queue);
+        notify = !m_mailboxFull;
+        m_mailbox = frame;
+        m_mailboxCaptured = captured;
+        m_mailboxFull = true;
     }
+
+    if (notify)
+        QMetaObject::invokeMethod(this, &Frames::deliverFrame, Qt::QueuedConnection);
+}
+
+void Frames::deliverFrame()
+{
+    QVideoFrame f;
+    quint64 captured;
+    {
+        QMutexLocker lock(&m_mailboxMutex);
+        if (!m_mailboxFull)
+            return;
+        f = m_mailbox;
+        captured = m_mailboxCaptured;
+        m_mailbox = QVideoFrame();
+        m_mailboxFull = false;
+    }
+
+    // Paused after the frame arrived
+    if (!m_running)
+    {
+        Profiler::instance().countDrop(Drop::Stopped);
+        return;
+    }
+
+    emit frameCaptured(f, captured);
 }
 
 
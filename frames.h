@@ -6,6 +6,8 @@
 #include <QMediaDevices>
 #include <QMediaCaptureSession>
 #include <QPointer>
+#include <QMutex>
+#include <atomic>
 
 class Frames
     :	public QVideoSink
@@ -15,7 +17,8 @@ class Frames
 
 signals:
     void imageCaptured(QImage&);
-    void frameCaptured(QVideoFrame&);
+    // captured is the arrival time in ScopedStageTimer::now() nanoseconds
+    void frameCaptured(QVideoFrame&, quint64 captured);
     void sendInfo(QString);
     void cameraListUpdated(const QStringList &cameraDevices);
 
@@ -39,13 +42,20 @@ public:
 private slots:
     void stopCam();
     void newFrame( const QVideoFrame&);
+    void deliverFrame();
 
 private:
     Q_DISABLE_COPY( Frames )
     QString getFormatString();
     QScopedPointer<QCamera> m_cam;
     QMediaCaptureSession m_capture;
-    bool m_running;
+    std::atomic<bool> m_running{false};
+
+    // Latest frame not yet handed to processing; a newer frame replaces it
+    QMutex m_mailboxMutex;
+    QVideoFrame m_mailbox;
+    quint64 m_mailboxCaptured = 0;
+    bool m_mailboxFull = false;
 };
 
 #endif // FRAMES_H
@@ -9,6 +9,7 @@ TARGET = HeartBeat
 
 QT += multimedia
 QT += multimediawidgets
+QT += network
 
 QMAKE_TARGET_BUNDLE_PREFIX = tbiliyor.com
 PRODUCT_BUNDLE_IDENTIFIER = $${QMAKE_TARGET_BUNDLE_PREFIX}.heartrate
@@ -19,17 +20,50 @@ PRODUCT_BUNDLE_IDENTIFIER = $${QMAKE_TARGET_BUNDLE_PREFIX}.heartrate
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    ContactPPG.cpp \
     RPPG.cpp \
+    beatdetector.cpp \
+    eventlog.cpp \
     frames.cpp \
     main.cpp \
     mainwindow.cpp \
-    opencv.cpp
+    metricsserver.cpp \
+    opencv.cpp \
+    overlaylayer.cpp \
+    presenter.cpp \
+    profiler.cpp \
+    roitrace.cpp
 
 HEADERS += \
+    ContactPPG.hpp \
     RPPG.hpp \
+    beatdetector.h \
+    eventlog.h \
     frames.h \
     mainwindow.h \
-    opencv.hpp
+    metricsserver.h \
+    opencv.hpp \
+    overlay.h \
+    overlaylayer.h \
+    presenter.h \
+    profiler.h \
+    roitrace.h \
+    slidingwindow.h \
+    trace.h
+
+# Per-stage allocation counts, logged on exit: qmake CONFIG+=allocations
+allocations {
+    CONFIG += profiling
+    DEFINES += HEARTBEAT_ALLOC_ACCOUNTING
+    SOURCES += alloccount.cpp
+    HEADERS += alloccount.h
+}
+
+# Per-stage latency histograms, HUD and trace export: qmake CONFIG+=profiling
+profiling {
+    DEFINES += HEARTBEAT_PROFILING
+    SOURCES += trace.cpp
+}
 
 FORMS += \
     mainwindow.ui
@@ -1,10 +1,24 @@
 #include "mainwindow.h"
+#include "eventlog.h"
 #include <QApplication>
 
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+#include "alloccount.h"
+#endif
+
 int main(int argc, char *argv[])
 {
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+    alloccount::install();
+#endif
     QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
-    return a.exec();
+    EventLog::instance().start();
+    int result;
+    {
+        MainWindow w;
+        w.show();
+        result = a.exec();
+    }
+    EventLog::instance().stop();
+    return result;
 }
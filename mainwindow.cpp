@@ -1,25 +1,47 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "opencv.hpp"
+#include "profiler.h"
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+#include "alloccount.h"
+#endif
+#include <QLabel>
+#include <QShortcut>
 #include <QTimer>
 
+#define HUD_INTERVAL_MS 500
+#define TRACE_DUMP_KEY "Ctrl+Shift+T"
+#define HRV_MIN_INTERVALS 10 // beat intervals before HRV is shown
+#define CLOCK_STALL_FRAMES 3 // frames with an unchanged capture time before arrival time is used
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
     m_instance = this;
+    m_clock.start();
 
     setWindowTitle("HeartRate Monitor Pro");
     setStyleSheet("background-color: #1E1E2E;");
 
-    setupUI();
+    // Detector models load in the background while the UI and cameras are set up
     initializeRPPG();
+    qint64 rppgTime = m_clock.elapsed();
+    setupUI();
+    qint64 uiTime = m_clock.elapsed();
 
 #if defined(Q_OS_ANDROID)
     requestAndroidPermissions();
 #else
     setupCamera();
 #endif
+    qint64 cameraTime = m_clock.elapsed();
+
+    qDebug() << "Startup took" << cameraTime << "ms: rppg" << rppgTime
+             << "ms, ui" << uiTime - rppgTime << "ms, camera" << cameraTime - uiTime << "ms";
+
+    setupMetrics();
 }
 
 void MainWindow::setupUI()
@@ -42,16 +64,36 @@ void MainWindow::setupUI()
     QScreen *primaryScreen = QGuiApplication::primaryScreen();
     QRect screenGeometry = primaryScreen->availableGeometry();
     setGeometry(screenGeometry);
-    ui->graphicsView->scene()->addItem(&pixmap);
-
-    QStringList files = {
-        ":/opencv/deploy.prototxt",
-        ":/opencv/haarcascade_frontalface_alt.xml",
-        ":/opencv/res10_300x300_ssd_iter_140000.caffemodel"
-    };
-    for (const QString &fileName : files) {
-        createFile(fileName);
+    presenter = new Presenter(ui->graphicsView, this);
+    overlayLayer = new OverlayLayer(presenter->item());
+
+#ifdef HEARTBEAT_PROFILING
+    // Stage latency HUD over the video, enabled by HEARTBEAT_HUD
+    if (qEnvironmentVariableIsSet("HEARTBEAT_HUD")) {
+        QLabel *hud = new QLabel(ui->graphicsView);
+        hud->setStyleSheet("font-family: monospace; font-size: 10pt; color: #E0E0E0; background-color: rgba(30, 30, 46, 180); padding: 4px;");
+        hud->setAttribute(Qt::WA_TransparentForMouseEvents);
+        hud->move(10, 10);
+        hud->show();
+        QTimer *hudTimer = new QTimer(hud);
+        connect(hudTimer, &QTimer::timeout, hud, [hud]() {
+            hud->setText(QString::fromStdString(Profiler::instance().report()));
+            hud->adjustSize();
+        });
+        hudTimer->start(HUD_INTERVAL_MS);
     }
+
+    // Chrome trace of the pipeline, written to HEARTBEAT_TRACE on exit and on TRACE_DUMP_KEY
+    if (qEnvironmentVariableIsSet("HEARTBEAT_TRACE")) {
+        Trace::setThreadName("gui");
+        Trace::start();
+        QShortcut *dumpShortcut = new QShortcut(QKeySequence(TRACE_DUMP_KEY), this);
+        connect(dumpShortcut, &QShortcut::activated, this, [this]() {
+            QString path = qEnvironmentVariable("HEARTBEAT_TRACE");
+            printInfo(Trace::dump(path.toStdString()) ? "Trace written to " + path : "Could not write trace to " + path);
+        });
+    }
+#endif
 }
 
 void MainWindow::initializeRPPG()
@@ -60,9 +102,29 @@ void MainWindow::initializeRPPG()
     connect(this, &MainWindow::cameraPermissionGranted, this, &MainWindow::onCameraPermissionGranted);
 #endif
 
+    // Beats are queued like any other signal argument, so their types are registered
+    qRegisterMetaType<Beat>();
+    qRegisterMetaType<HrvStats>();
+
     rppg = new RPPG();
     connect(rppg, &RPPG::sendInfo, this, &MainWindow::printInfo);
-    rppg->load(0, HAAR_CLASSIFIER_PATH, DNN_PROTO_PATH, DNN_MODEL_PATH);
+    connect(rppg, &RPPG::sendBeat, this, &MainWindow::onBeat);
+
+    contactPpg = new ContactPPG();
+    connect(contactPpg, &ContactPPG::sendInfo, this, &MainWindow::printInfo);
+    connect(contactPpg, &ContactPPG::fingerPresenceChanged, this, &MainWindow::onFingerPresenceChanged);
+    rppg->load(HAAR_CLASSIFIER_PATH, DNN_PROTO_PATH, DNN_MODEL_PATH);
+
+    // ROI trace of the session for later reanalysis, written to HEARTBEAT_RECORD
+    if (qEnvironmentVariableIsSet("HEARTBEAT_RECORD")) {
+        QString path = qEnvironmentVariable("HEARTBEAT_RECORD");
+        recorder = new RoiTraceWriter();
+        if (recorder->open(path.toStdString())) {
+            rppg->setRecorder(recorder);
+        } else {
+            qDebug() << "Could not record to" << path;
+        }
+    }
 }
 
 void MainWindow::setupCamera()
@@ -77,6 +139,17 @@ void MainWindow::setupCamera()
     }
 }
 
+void MainWindow::setupMetrics()
+{
+    // Prometheus endpoint for unattended units, on the port given by HEARTBEAT_METRICS_PORT
+    bool ok = false;
+    int port = qEnvironmentVariableIntValue("HEARTBEAT_METRICS_PORT", &ok);
+    if (ok && port > 0 && port <= 65535) {
+        metricsServer = new MetricsServer(port);
+        connect(metricsServer, &MetricsServer::sendInfo, this, &MainWindow::printInfo);
+    }
+}
+
 #if defined(Q_OS_ANDROID)
 void MainWindow::requestAndroidPermissions()
 {
@@ -113,60 +186,41 @@ void MainWindow::onCameraPermissionGranted()
 }
 #endif
 
-void MainWindow::createFile(const QString &fileName)
+qint64 MainWindow::frameTimestamp(const QVideoFrame &frame)
 {
-    QString data;
-    QFile file(fileName);
-
-    if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "Error: Could not open file for reading: " << fileName;
-        return;
-    } else {
-        data = file.readAll();
-        file.close();
-    }
-
-    QString filename = fileName.mid(fileName.lastIndexOf("/") + 1);
-    QString tempFilePath;
-
-#if defined(Q_OS_IOS) || defined(Q_OS_ANDROID)
-    QString iosWritablePath = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-    tempFilePath = iosWritablePath + "/" + filename;
-#else
-    tempFilePath = filename;
-#endif
-
-    QFile temp(tempFilePath);
-
-    if (temp.exists()) {
-        qDebug() << "Warning: File already exists: " << tempFilePath;
-        return;
+    // Frame clock in milliseconds; the engines drop a repeated time, but a capture clock
+    // that stops advancing would drop every frame, so the camera falls back to arrival time
+    if (!arrivalClock && frame.startTime() >= 0) {
+        qint64 time = frame.startTime() / 1000;
+        stalledFrames = time == lastCaptureTime ? stalledFrames + 1 : 0;
+        lastCaptureTime = time;
+        if (stalledFrames < CLOCK_STALL_FRAMES) {
+            return time;
+        }
     }
-
-    if (temp.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream stream(&temp);
-        stream << data;
-        temp.close();
-        qDebug() << "Data written to file: " << tempFilePath;
-    } else {
-        qDebug() << "Error: Could not open file for writing: " << tempFilePath;
+    if (!arrivalClock) {
+        // Capture and arrival times share no origin, so the signals restart on the new clock
+        arrivalClock = true;
+        rppg->reset();
+        contactPpg->reset();
     }
+    return m_clock.elapsed();
 }
 
-float MainWindow::getPulseValue(const Mat& maskedRed) {
-    Scalar mean = cv::mean(maskedRed);
-    return mean[0];  // Return average intensity of the masked region
-}
-
-void MainWindow::processFrame(QVideoFrame &frame)
+void MainWindow::processFrame(QVideoFrame &frame, quint64 captured)
 {
+    TRACE_SCOPE("frame");
     if (frame.isValid()) {
         double heartRate = 0.0;
-        QVideoFrame cloneFrame(frame);
-        cloneFrame.map(QVideoFrame::ReadOnly);
-        QImage img = cloneFrame.toImage();
-        cloneFrame.unmap();
-        img = img.convertToFormat(QImage::Format_RGB888);
+        QImage img;
+        {
+            PROFILE_STAGE(Stage::Ingest);
+            QVideoFrame cloneFrame(frame);
+            cloneFrame.map(QVideoFrame::ReadOnly);
+            img = cloneFrame.toImage();
+            cloneFrame.unmap();
+            img = img.convertToFormat(QImage::Format_RGB888);
+        }
 
         Mat frameRGB(img.height(),
                      img.width(),
@@ -174,174 +228,67 @@ void MainWindow::processFrame(QVideoFrame &frame)
                      img.bits(),
                      img.bytesPerLine());
 
+        Profiler &metrics = Profiler::instance();
         if(!frontCamEnabled)
         {
-            if (!frameRGB.empty()) {
-                std::vector<Mat> channels;
-                split(frameRGB, channels);
-                Mat redChannel = channels[2];
-
-                Mat mask = Mat::zeros(redChannel.size(), CV_8UC1);
-                int centerX = redChannel.cols / 2;
-                int centerY = redChannel.rows / 2;
-                int roiSize = std::min(redChannel.cols, redChannel.rows) / 3;
-                cv::circle(mask, Point(centerX, centerY), roiSize, Scalar(255), -1);
-
-                Mat maskedRed;
-                redChannel.copyTo(maskedRed, mask);
-
-                heartRate = calculateInstantHeartRate(maskedRed, mask);
-                static std::vector<float> pulseBuffer;
-                const int bufferSize = 200;
-
-                pulseBuffer.push_back(heartRate);
-                if (pulseBuffer.size() > bufferSize) {
-                    pulseBuffer.erase(pulseBuffer.begin());
-                }
-
-                Mat displayFrame;
-                cvtColor(maskedRed, displayFrame, COLOR_GRAY2BGR);
-
-                if (pulseBuffer.size() > 1) {
-                    auto minmax = std::minmax_element(pulseBuffer.begin(), pulseBuffer.end());
-                    float minVal = *minmax.first;
-                    float maxVal = *minmax.second;
-                    float range = maxVal - minVal;
-
-                    int lineY = centerY;
-                    int startX = centerX - roiSize;
-                    int endX = centerX + roiSize;
-
-                    // İnce grid çizgileri
-                    for(int y = lineY - roiSize/3; y <= lineY + roiSize/3; y += roiSize/10) {
-                        line(displayFrame, Point(startX, y), Point(endX, y), Scalar(50, 50, 50), 1);
-                    }
-                    for(int x = startX; x <= endX; x += roiSize/10) {
-                        line(displayFrame, Point(x, lineY - roiSize/3), Point(x, lineY + roiSize/3), Scalar(50, 50, 50), 1);
-                    }
-
-                    // Ana referans çizgisi
-                    line(displayFrame, Point(startX, lineY), Point(endX, lineY), Scalar(100, 100, 100), 2);
-
-                    std::vector<Point> points;
-                    int segmentWidth = (endX - startX) / pulseBuffer.size();
-
-                    // Sinyal yumuşatma için cubic spline noktaları
-                    std::vector<Point> splinePoints;
-                    const int SMOOTHING_WINDOW = 5;
-
-                    for (size_t i = 0; i < pulseBuffer.size(); ++i) {
-                        // Hareketli ortalama ile yumuşatma
-                        double smoothedValue = 0;
-                        int count = 0;
-
-                        for (int j = -SMOOTHING_WINDOW; j <= SMOOTHING_WINDOW; j++) {
-                            if (i + j >= 0 && i + j < pulseBuffer.size()) {
-                                smoothedValue += pulseBuffer[i + j];
-                                count++;
-                            }
-                        }
-                        smoothedValue /= count;
-
-                        float normalizedValue = (smoothedValue - minVal) / range;
-                        int x = startX + i * segmentWidth;
-                        int y = lineY - normalizedValue * (roiSize/3);
-                        splinePoints.push_back(Point(x, y));
-                    }
-
-                    // Cubic spline interpolasyon için ara noktalar
-                    for (size_t i = 0; i < splinePoints.size() - 1; ++i) {
-                        Point p0 = (i > 0) ? splinePoints[i-1] : splinePoints[i];
-                        Point p1 = splinePoints[i];
-                        Point p2 = splinePoints[i+1];
-                        Point p3 = (i < splinePoints.size()-2) ? splinePoints[i+2] : p2;
-
-                        // Her iki nokta arasında 5 ara nokta oluştur
-                        for (int t = 0; t < 5; ++t) {
-                            float tt = t / 5.0f;
-
-                            // Catmull-Rom spline formülü
-                            float tt2 = tt * tt;
-                            float tt3 = tt2 * tt;
-
-                            float x = 0.5f * ((2.0f * p1.x) +
-                                              (-p0.x + p2.x) * tt +
-                                              (2.0f * p0.x - 5.0f * p1.x + 4.0f * p2.x - p3.x) * tt2 +
-                                              (-p0.x + 3.0f * p1.x - 3.0f * p2.x + p3.x) * tt3);
-
-                            float y = 0.5f * ((2.0f * p1.y) +
-                                              (-p0.y + p2.y) * tt +
-                                              (2.0f * p0.y - 5.0f * p1.y + 4.0f * p2.y - p3.y) * tt2 +
-                                              (-p0.y + 3.0f * p1.y - 3.0f * p2.y + p3.y) * tt3);
-
-                            points.push_back(Point(round(x), round(y)));
-                        }
-                        points.push_back(p2);
-
-                        // Peak noktalarında spike ekle
-                        if (i > 0 && i < splinePoints.size()-1) {
-                            if (splinePoints[i].y < splinePoints[i-1].y &&
-                                splinePoints[i].y < splinePoints[i+1].y) {
-                                int x = splinePoints[i].x;
-                                int y = splinePoints[i].y;
-                                points.push_back(Point(x, y - 12));
-                                points.push_back(Point(x + 2, y + 8));
-                                points.push_back(Point(x + 4, y));
-                            }
-                        }
-                    }
-
-                    // Sinyal çizimi
-                    Scalar signalColor(0, 255, 255); // Sabit sarı renk
-                    for (size_t i = 0; i < points.size() - 1; ++i) {
-                        line(displayFrame, points[i], points[i + 1], signalColor, 2);
-                    }
-                }
-
-                // Daire çizimi
-                cv::circle(displayFrame, Point(centerX, centerY), roiSize, Scalar(0, 255, 255), 2);
-
-                displayFrame.copyTo(frameRGB, mask);
-
-                // BPM text
-                std::string bpmText = std::to_string(static_cast<int>(std::round(heartRate))) + " BPM";
-                int fontFace = FONT_HERSHEY_DUPLEX;
-                double fontScale = 1.5;
-                int thickness = 2;
-                int baseline = 0;
-                Size textSize = getTextSize(bpmText, fontFace, fontScale, thickness, &baseline);
-                Point textOrg(centerX - textSize.width / 2, centerY - roiSize/2);
-
-                putText(frameRGB, bpmText, textOrg, fontFace, fontScale, Scalar(0, 0, 0), thickness + 1);
-                putText(frameRGB, bpmText, textOrg, fontFace, fontScale, Scalar(255, 255, 255), thickness);
-            }
+            heartRate = contactPpg->processFrame(frameRGB, frameTimestamp(frame));
+            overlayLayer->clear();
         }
         else
         {
             Mat frameGray;
-            cvtColor((InputArray)frameRGB, (OutputArray)frameGray, COLOR_BGR2GRAY);
-            equalizeHist((InputArray)frameGray, (OutputArray)frameGray);
+            {
+                PROFILE_STAGE(Stage::Equalize);
+                cvtColor((InputArray)frameRGB, (OutputArray)frameGray, COLOR_BGR2GRAY);
+                equalizeHist((InputArray)frameGray, (OutputArray)frameGray);
+            }
 
-            heartRate = rppg->processFrame(frameRGB, frameGray);
+            heartRate = rppg->processFrame(frameRGB, frameGray, frameTimestamp(frame));
+
+            metrics.set(Gauge::Fps, rppg->getFrameRate());
+            metrics.set(Gauge::Confidence, rppg->getConfidence());
+            metrics.set(Gauge::Quality, rppg->getQuality());
+            metrics.set(Gauge::TimeToFirstBpm, rppg->getTimeToFirstBpm());
+
+            PROFILE_STAGE(Stage::Draw);
+            overlayLayer->update(rppg->getOverlay());
         }
+        metrics.set(Gauge::Bpm, heartRate);
+        metrics.count(Counter::Frames);
 
         std::stringstream ss;
-        ss << std::fixed << std::setprecision(0)
-           << heartRate << " BPM";
+        ss << std::fixed << std::setprecision(0);
+        if (!frontCamEnabled && !fingerPresent) {
+            ss << "-- BPM";
+        } else {
+            ss << heartRate << " BPM";
+        }
 
-        printValue(ss.str().c_str());
+        // Progressive readings are shown with their confidence until the full window is reached
+        if (frontCamEnabled && heartRate > 0 && rppg->getConfidence() < 1.0) {
+            ss << " (" << rppg->getConfidence() * 100 << "%)";
+        }
+        if (frontCamEnabled && rppg->getRespirationRate() > 0) {
+            ss << "  " << rppg->getRespirationRate() << " br/min";
+        }
+        if (frontCamEnabled && heartRate > 0 && hrv.count >= HRV_MIN_INTERVALS) {
+            ss << "  HRV " << hrv.rmssd << " ms";
+        }
+        if (!frontCamEnabled && contactPpg->getSpO2() > 0) {
+            ss << "  SpO2 " << contactPpg->getSpO2() << "%";
+        }
 
-        QImage img_processed((uchar*)frameRGB.data, frameRGB.cols, frameRGB.rows,
-                             frameRGB.step, QImage::Format_RGB888);
+        printValue(ss.str().c_str());
+        metrics.record(Latency::CaptureToResult, ScopedStageTimer::now() - captured);
 
-        processImage(img_processed);
+        // frameRGB shares its pixels with img, so the processed frame is handed over without a copy
+        processImage(img, captured);
     }
 }
 
-void MainWindow::processImage(QImage &img_face)
+void MainWindow::processImage(QImage &img_face, quint64 captured)
 {
-    pixmap.setPixmap(QPixmap::fromImage(img_face));
-    ui->graphicsView->fitInView(&pixmap, Qt::KeepAspectRatio);
+    presenter->submit(img_face, captured);
 }
 
 void MainWindow::printInfo(QString info)
@@ -354,6 +301,22 @@ void MainWindow::printValue(QString bpm)
     ui->textBpm->setText(bpm);
 }
 
+void MainWindow::onBeat(Beat, HrvStats stats)
+{
+    hrv = stats;
+    Profiler &metrics = Profiler::instance();
+    metrics.count(Counter::Beats);
+    metrics.set(Gauge::Rmssd, stats.rmssd / 1000.0);
+    metrics.set(Gauge::Sdnn, stats.sdnn / 1000.0);
+}
+
+void MainWindow::onFingerPresenceChanged(bool present)
+{
+    fingerPresent = present;
+    // The fingertip reading restarts with every contact
+    ui->textBpm->setText("-- BPM");
+}
+
 void MainWindow::on_pushExit_clicked()
 {
     qApp->exit();
@@ -368,6 +331,14 @@ void MainWindow::onCameraListUpdated(const QStringList &cameraDevices)
 void MainWindow::on_cameraComboBox_currentIndexChanged(int index)
 {
     frontCamEnabled = false;
+    contactPpg->reset();
+    // The new camera's signal must not be mixed into the old one's window
+    rppg->reset();
+    hrv = HrvStats();
+    // and its capture clock gets a new chance
+    arrivalClock = false;
+    lastCaptureTime = -1;
+    stalledFrames = 0;
     m_frames->setRunning(false);
 
     QString selectedText = ui->cameraComboBox->itemText(index);
@@ -383,12 +354,39 @@ void MainWindow::on_cameraComboBox_currentIndexChanged(int index)
 
 MainWindow::~MainWindow()
 {
+    qDebug().noquote() << "Frame latencies\n" + QString::fromStdString(Profiler::instance().report());
+#ifdef HEARTBEAT_ALLOC_ACCOUNTING
+    qDebug().noquote() << "Allocations\n" + QString::fromStdString(alloccount::report(Profiler::instance().value(Counter::Frames)));
+#endif
+
+#ifdef HEARTBEAT_PROFILING
+    if (Trace::enabled()) {
+        Trace::stop();
+        QString path = qEnvironmentVariable("HEARTBEAT_TRACE");
+        if (!Trace::dump(path.toStdString())) {
+            qDebug() << "Could not write trace to" << path;
+        }
+    }
+#endif
+
+    if(metricsServer)
+        delete metricsServer;
+
     if(m_frames)
         delete m_frames;
 
     if(rppg)
         delete rppg;
 
+    if(recorder)
+        delete recorder;
+
+    if(contactPpg)
+        delete contactPpg;
+
+    if(overlayLayer)
+        delete overlayLayer;
+
     delete ui;
 }
 
@@ -403,80 +401,3 @@ Java_org_tbiliyor_heartbeat_MainActivity_notifyCameraPermissionGranted(JNIEnv *e
 }
 }
 #endif
-
-double MainWindow::getFilteredBpm(double newBpm) {
-    double kalmanFilteredBpm = bpmKalman.update(newBpm);
-
-    // Second level of filtering using EMA
-    double alpha = 0.1; // Smoothing factor (0 < alpha <= 1)
-    double emaFilteredBpm = (alpha * kalmanFilteredBpm) + ((1 - alpha) * previousEma);
-
-    // Update the previous EMA value
-    previousEma = emaFilteredBpm;
-
-    return emaFilteredBpm;
-}
-
-double MainWindow::calculateInstantHeartRate(const cv::Mat& currentFrame, const cv::Mat& mask) {
-    static std::deque<double> intensities;
-    static const int BUFFER_SIZE = 50;
-    static double lastValidBpm = 0.0;
-
-    cv::Scalar mean = cv::mean(currentFrame, mask);
-    double intensity = mean[0];
-
-    // Store intensity in buffer
-    if (intensities.size() >= BUFFER_SIZE) {
-        intensities.pop_front();
-    }
-
-    intensities.push_back(intensity);
-
-    if (intensities.size() < BUFFER_SIZE) {
-        return lastValidBpm;
-    }
-
-    // Calculate threshold
-    double maxVal = *std::max_element(intensities.begin(), intensities.end());
-    double minVal = *std::min_element(intensities.begin(), intensities.end());
-    double mean_val = std::accumulate(intensities.begin(), intensities.end(), 0.0) / intensities.size();
-    double threshold = mean_val + 0.2 * (maxVal - minVal);
-
-    // Detect peaks
-    std::vector<int> peakIndices;
-    const int minDistance = 19;
-    const int maxDistance = 31;
-
-    for (size_t i = 1; i < intensities.size() - 1; i++) {
-        if (!peakIndices.empty() && i - peakIndices.back() < minDistance) {
-            continue;
-        }
-        if (intensities[i] > threshold &&
-            intensities[i] > intensities[i - 1] &&
-            intensities[i] > intensities[i + 1]) {
-            peakIndices.push_back(i);
-        }
-    }
-
-    // Calculate BPM
-    double bpm = 0.0;
-    if (peakIndices.size() >= 2) {
-        std::vector<double> intervals;
-        for (size_t i = 1; i < peakIndices.size(); i++) {
-            int interval = peakIndices[i] - peakIndices[i - 1];
-            if (interval >= minDistance && interval <= maxDistance) {
-                intervals.push_back(interval);
-            }
-        }
-        if (!intervals.empty()) {
-            double avgInterval = std::accumulate(intervals.begin(), intervals.end(), 0.0) / intervals.size();
-            bpm = (30.0 * 55.0) / avgInterval; // Convert frame interval to BPM
-        }
-    }
-
-    if (bpm >= 70 && bpm <= 90) { // Adjusted valid range
-        lastValidBpm = getFilteredBpm(bpm);
-    }
-
-    return lastValidBpm;
-}
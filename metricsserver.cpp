@@ -0,0 +1,128 @@
+#include "metricsserver.h"
+#include "eventlog.h"
+#include "profiler.h"
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <cstdarg>
+#include <cstdio>
+
+#define MAX_REQUEST_SIZE 8192
+
+static void appendLine(QByteArray &text, const char *format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    text += line;
+    text += '\n';
+}
+
+// Latencies as summaries in seconds; the histograms only keep quantiles and totals
+static void appendSummary(QByteArray &text, const char *metric, const char *label, const char *name, const StageStats &s) {
+    const double quantiles[] = {0.5, 0.95, 0.99};
+    const double values[] = {s.p50, s.p95, s.p99};
+    for (int i = 0; i < 3; i++) {
+        appendLine(text, "%s{%s=\"%s\",quantile=\"%g\"} %.9g", metric, label, name, quantiles[i], values[i] * 1e-6);
+    }
+    appendLine(text, "%s_sum{%s=\"%s\"} %.9g", metric, label, name, s.mean * s.count * 1e-6);
+    appendLine(text, "%s_count{%s=\"%s\"} %llu", metric, label, name, (unsigned long long)s.count);
+}
+
+QByteArray MetricsServer::render() {
+    const Profiler &profiler = Profiler::instance();
+    QByteArray text;
+
+    for (int i = 0; i < (int)Counter::Count; i++) {
+        const char *name = counterName((Counter)i);
+        appendLine(text, "# TYPE heartbeat_%s_total counter", name);
+        appendLine(text, "heartbeat_%s_total %llu", name, (unsigned long long)profiler.value((Counter)i));
+    }
+
+    appendLine(text, "# TYPE heartbeat_dropped_frames_total counter");
+    for (int i = 0; i < (int)Drop::Count; i++) {
+        appendLine(text, "heartbeat_dropped_frames_total{reason=\"%s\"} %llu", dropName((Drop)i),
+                   (unsigned long long)profiler.dropCount((Drop)i));
+    }
+
+    appendLine(text, "# TYPE heartbeat_log_dropped_total counter");
+    appendLine(text, "heartbeat_log_dropped_total %llu", (unsigned long long)EventLog::instance().droppedCount());
+
+    for (int i = 0; i < (int)Gauge::Count; i++) {
+        const char *name = gaugeName((Gauge)i);
+        appendLine(text, "# TYPE heartbeat_%s gauge", name);
+        appendLine(text, "heartbeat_%s %.6g", name, profiler.value((Gauge)i));
+    }
+
+    // Frame age from arrival at the video sink
+    appendLine(text, "# TYPE heartbeat_frame_age_seconds summary");
+    appendSummary(text, "heartbeat_frame_age_seconds", "until", "result", profiler.stats(Latency::CaptureToResult));
+    appendSummary(text, "heartbeat_frame_age_seconds", "until", "display", profiler.stats(Latency::CaptureToDisplay));
+
+    // Stage timers only record in profiling builds
+    appendLine(text, "# TYPE heartbeat_stage_seconds summary");
+    for (int i = 0; i < (int)Stage::Count; i++) {
+        StageStats s = profiler.stats((Stage)i);
+        if (s.count > 0) {
+            appendSummary(text, "heartbeat_stage_seconds", "stage", stageName((Stage)i), s);
+        }
+    }
+    return text;
+}
+
+static void respond(QTcpSocket *socket, const QByteArray &request) {
+    QList<QByteArray> requestLine = request.left(request.indexOf('\r')).split(' ');
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (requestLine.size() < 2 || requestLine[0] != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (requestLine[1] != "/metrics") {
+        status = "404 Not Found";
+    } else {
+        body = MetricsServer::render();
+    }
+    socket->write("HTTP/1.1 " + status + "\r\n"
+                  "Content-Type: text/plain; version=0.0.4\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Connection: close\r\n\r\n" + body);
+    socket->disconnectFromHost();
+}
+
+MetricsServer::MetricsServer(quint16 port, QObject *parent)
+    : QObject(parent)
+{
+    // Created here, listening and all socket handling happen on the server thread
+    QTcpServer *server = new QTcpServer();
+    server->moveToThread(&thread);
+    connect(&thread, &QThread::finished, server, &QObject::deleteLater);
+
+    connect(&thread, &QThread::started, server, [this, server, port]() {
+        // Only reachable from the unit itself
+        if (!server->listen(QHostAddress::LocalHost, port)) {
+            emit sendInfo("Metrics server could not listen on port " + QString::number(port));
+            return;
+        }
+        connect(server, &QTcpServer::newConnection, server, [server]() {
+            while (QTcpSocket *socket = server->nextPendingConnection()) {
+                connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+                connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+                    QByteArray request = socket->peek(MAX_REQUEST_SIZE);
+                    if (request.contains("\r\n\r\n") || request.size() >= MAX_REQUEST_SIZE) {
+                        socket->readAll();
+                        respond(socket, request);
+                    }
+                });
+            }
+        });
+    });
+
+    thread.setObjectName("metrics");
+    thread.start();
+}
+
+MetricsServer::~MetricsServer()
+{
+    thread.quit();
+    thread.wait();
+}
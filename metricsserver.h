@@ -0,0 +1,29 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QThread>
+
+// Serves the Profiler's counters, gauges and latencies in Prometheus text format at
+// http://127.0.0.1:<port>/metrics. The server runs on its own thread and only reads the
+// Profiler's atomics, so a scrape never waits on the frame loop.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(quint16 port, QObject *parent = nullptr);
+    ~MetricsServer();
+
+    // Current metrics in exposition format
+    static QByteArray render();
+
+signals:
+    void sendInfo(QString);
+
+private:
+    QThread thread;
+};
+
+#endif // METRICSSERVER_H
@@ -34,6 +34,44 @@ void push(Mat &m) {
     m.pop_back();
 }
 
+// Per channel mean of an 8-bit 3-channel image over a filled circle, in a single pass over the covered rows
+Scalar discMean(const Mat &img, Point centre, int radius) {
+
+    CV_Assert(img.type() == CV_8UC3 && radius >= 0);
+
+    uint64_t sum[3] = {0, 0, 0};
+    uint64_t count = 0;
+
+    int y0 = max(centre.y - radius, 0);
+    int y1 = min(centre.y + radius, img.rows - 1);
+    for (int y = y0; y <= y1; y++) {
+        int dy = y - centre.y;
+        int half = (int)sqrt((double)(radius * radius - dy * dy));
+        int x0 = max(centre.x - half, 0);
+        int x1 = min(centre.x + half, img.cols - 1);
+        if (x0 > x1) {
+            continue;
+        }
+
+        const uchar *p = img.ptr<uchar>(y) + 3 * x0;
+        uint32_t r = 0, g = 0, b = 0;
+        for (int x = x0; x <= x1; x++, p += 3) {
+            r += p[0];
+            g += p[1];
+            b += p[2];
+        }
+        sum[0] += r;
+        sum[1] += g;
+        sum[2] += b;
+        count += x1 - x0 + 1;
+    }
+
+    if (count == 0) {
+        return Scalar::all(0);
+    }
+    return Scalar((double)sum[0] / count, (double)sum[1] / count, (double)sum[2] / count);
+}
+
 void plot(cv::Mat &mat) {
     while (true) {
         cv::imshow("plot", mat);
@@ -54,58 +92,123 @@ void normalization(InputArray _a, OutputArray _b) {
     }
 }
 
-// Eliminate jumps
+// Eliminate jumps: from every flagged row on, the step from the row before is subtracted.
+// A running offset per column does this in one pass.
 void denoise(InputArray _a, InputArray _jumps, OutputArray _b) {
 
-    Mat a = _a.getMat().clone();
-    Mat jumps = _jumps.getMat().clone();
+    Mat a = _a.getMat();
+    Mat jumps = _jumps.getMat();
 
-    CV_Assert(a.type() == CV_64F && jumps.type() == CV_8U);
+    CV_Assert(a.type() == CV_64F && jumps.type() == CV_8U && jumps.rows >= a.rows);
 
-    if (jumps.rows != a.rows) {
-        jumps.rowRange(jumps.rows-a.rows, jumps.rows).copyTo(jumps);
+    if (a.rows == 0) {
+        a.copyTo(_b);
+        return;
     }
 
-    Mat diff;
-    subtract(a.rowRange(1, a.rows), a.rowRange(0, a.rows-1), diff);
+    // Jumps may cover a longer buffer; its newest rows line up with a
+    const int first = jumps.rows - a.rows;
 
-    for (int i = 1; i < jumps.rows; i++) {
-        if (jumps.at<bool>(i, 0)) {
-            Mat mask = Mat::zeros(a.size(), CV_8U);
-            mask.rowRange(i, mask.rows).setTo(ONE);
-            for (int j = 0; j < a.cols; j++) {
-                add(a.col(j), -diff.at<double>(i-1, j), a.col(j), mask.col(j));
+    _b.create(a.rows, a.cols, CV_64F);
+    Mat b = _b.getMat();
+
+    for (int j = 0; j < a.cols; j++) {
+        double offset = 0.0;
+        double previous = a.at<double>(0, j);
+        b.at<double>(0, j) = previous;
+        for (int i = 1; i < a.rows; i++) {
+            double value = a.at<double>(i, j);
+            if (jumps.at<uchar>(first + i, 0)) {
+                offset += value - previous;
             }
+            previous = value;
+            b.at<double>(i, j) = value - offset;
         }
     }
-
-    a.copyTo(_b);
 }
 
-// Advanced detrending filter based on smoothness priors approach (High pass equivalent)
+// Advanced detrending filter based on smoothness priors approach (High pass equivalent).
+// b = (I - (I + λ^2 * D2^t*D2)^-1) * a = a - x with (I + λ^2 * D2^t*D2) x = a. The matrix is
+// pentadiagonal, so x comes from a banded LDL^t factorisation in O(rows) instead of a dense
+// rows x rows inverse.
 void detrend(InputArray _a, OutputArray _b, int lambda) {
 
     Mat a = _a.getMat();
     CV_Assert(a.type() == CV_64F);
 
     // Number of rows
-    int rows = a.rows;
+    const int rows = a.rows;
 
     if (rows < 3) {
         a.copyTo(_b);
-    } else {
-        // Construct I
-        Mat i = Mat::eye(rows, rows, a.type());
-        // Construct D2
-        Mat d = Mat(Matx<double,1,3>(1, -2, 1));
-        Mat d2Aux = Mat::ones(rows-2, 1, a.type()) * d;
-        Mat d2 = Mat::zeros(rows-2, rows, a.type());
-        for (int k = 0; k < 3; k++) {
-            d2Aux.col(k).copyTo(d2.diag(k));
+        return;
+    }
+
+    // Scratch grows to the longest signal seen and is reused after that
+    thread_local std::vector<double> scratch;
+    scratch.resize(4 * rows);
+    double *d = scratch.data();     // diagonal, then the pivots
+    double *l1 = d + rows;          // first off-diagonal, then the first subdiagonal of L
+    double *l2 = l1 + rows;         // second off-diagonal, then the second subdiagonal of L
+    double *x = l2 + rows;
+
+    // Bands of I + λ^2 * D2^t*D2; every (1, -2, 1) row of D2 adds its outer product
+    const double w = (double)lambda * lambda;
+    for (int i = 0; i < rows; i++) {
+        d[i] = 1.0;
+        l1[i] = 0.0;
+        l2[i] = 0.0;
+    }
+    for (int k = 0; k < rows - 2; k++) {
+        d[k] += w;
+        d[k + 1] += 4 * w;
+        d[k + 2] += w;
+        l1[k] -= 2 * w;
+        l1[k + 1] -= 2 * w;
+        l2[k] += w;
+    }
+
+    // Factorise in place; the matrix is symmetric positive definite, so no pivoting
+    for (int i = 0; i < rows; i++) {
+        if (i >= 1) {
+            d[i] -= l1[i - 1] * l1[i - 1] * d[i - 1];
+            l1[i] -= l2[i - 1] * l1[i - 1] * d[i - 1];
+        }
+        if (i >= 2) {
+            d[i] -= l2[i - 2] * l2[i - 2] * d[i - 2];
+        }
+        l1[i] /= d[i];
+        l2[i] /= d[i];
+    }
+
+    _b.create(rows, a.cols, CV_64F);
+    Mat b = _b.getMat();
+
+    for (int c = 0; c < a.cols; c++) {
+        // L z = a, then D L^t x = z
+        for (int i = 0; i < rows; i++) {
+            double v = a.at<double>(i, c);
+            if (i >= 1) {
+                v -= l1[i - 1] * x[i - 1];
+            }
+            if (i >= 2) {
+                v -= l2[i - 2] * x[i - 2];
+            }
+            x[i] = v;
+        }
+        for (int i = rows - 1; i >= 0; i--) {
+            double v = x[i] / d[i];
+            if (i + 1 < rows) {
+                v -= l1[i] * x[i + 1];
+            }
+            if (i + 2 < rows) {
+                v -= l2[i] * x[i + 2];
+            }
+            x[i] = v;
+        }
+        for (int i = 0; i < rows; i++) {
+            b.at<double>(i, c) = a.at<double>(i, c) - x[i];
         }
-        // Calculate b = (I - (I + λ^2 * D2^t*D2)^-1) * a
-        Mat b = (i - (i + lambda * lambda * d2.t() * d2).inv()) * a;
-        b.copyTo(_b);
     }
 }
 
@@ -257,6 +360,71 @@ void pcaComponent(cv::InputArray _a, cv::OutputArray _b, cv::OutputArray _pc, in
     pc.copyTo(_pc);
 }
 
+/* ESTIMATION */
+
+// Strongest frequency between low and high, all in cycles per minute.
+// With nfft > rows the signal is zero-padded, so short windows share the bin spacing of long ones.
+double dominantFrequency(InputArray _a, double fps, double low, double high, int nfft, double *snr) {
+
+    Mat a = _a.getMat();
+    CV_Assert(a.cols == 1);
+
+    if (nfft < a.rows) {
+        nfft = a.rows;
+    }
+
+    Mat padded;
+    copyMakeBorder(a, padded, 0, nfft - a.rows, 0, 0, BORDER_CONSTANT, ZERO);
+
+    Mat magnitude = Mat(nfft, 1, CV_32F);
+    timeToFrequency(padded, magnitude, true);
+
+    // Band in bins, limited to the non-mirrored half
+    int lowBin = (int)ceil(low * nfft / 60.0 / fps);
+    int highBin = (int)floor(high * nfft / 60.0 / fps);
+    lowBin = max(lowBin, 1);
+    highBin = min(highBin, nfft / 2);
+    if (lowBin > highBin) {
+        return 0.0;
+    }
+
+    double vmin, vmax;
+    Point pmin, pmax;
+    minMaxLoc(magnitude.rowRange(lowBin, highBin + 1), &vmin, &vmax, &pmin, &pmax);
+
+    if (snr) {
+        *snr = spectralQuality(magnitude, lowBin, highBin, lowBin + pmax.y);
+    }
+
+    return (lowBin + pmax.y) * fps / nfft * 60.0;
+}
+
+// Power of the peak bin and its neighbours against the rest of the band, in dB
+double spectralQuality(InputArray _spectrum, int low, int high, int peak) {
+
+    Mat spectrum;
+    _spectrum.getMat().convertTo(spectrum, CV_64F);
+
+    double peakPower = 0.0, bandPower = 0.0;
+    for (int i = max(low, 0); i <= high && i < spectrum.rows; i++) {
+        double p = spectrum.at<double>(i, 0);
+        p *= p;
+        bandPower += p;
+        if (abs(i - peak) <= 1) {
+            peakPower += p;
+        }
+    }
+
+    double rest = bandPower - peakPower;
+    if (peakPower <= 0) {
+        return -100.0;
+    }
+    if (rest <= peakPower * 1e-10) {
+        return 100.0;
+    }
+    return 10 * log10(peakPower / rest);
+}
+
 /* LOGGING */
 
 void printMagnitude(String title, Mat &powerSpectrum) {
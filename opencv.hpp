@@ -23,6 +23,7 @@ namespace cv {
 
     double getFps(cv::Mat &t, const double timeBase);
     void push(cv::Mat &m);
+    cv::Scalar discMean(const cv::Mat &img, cv::Point centre, int radius);
     void plot(cv::Mat &mat);
 
     /* FILTERS */
@@ -38,6 +39,11 @@ namespace cv {
     void timeToFrequency(cv::InputArray _a, cv::OutputArray _b, bool magnitude);
     void pcaComponent(cv::InputArray _a, cv::OutputArray _b, cv::OutputArray _pc, int low, int high);
 
+    /* ESTIMATION */
+
+    double dominantFrequency(cv::InputArray _a, double fps, double low, double high, int nfft = 0, double *snr = nullptr);
+    double spectralQuality(cv::InputArray _spectrum, int low, int high, int peak);
+
     /* LOGGING */
 
     void printMatInfo(const std::string &name, InputArray _a);
@@ -0,0 +1,65 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Vector description of the annotations for one frame, in image pixel coordinates.
+// Colours are in the frame's RGB order.
+
+struct OverlayBox {
+    cv::Rect rect;
+    cv::Scalar color;
+    int thickness = 1;   // < 0 fills the box
+
+    bool operator==(const OverlayBox &o) const {
+        return rect == o.rect && color == o.color && thickness == o.thickness;
+    }
+};
+
+struct OverlayLabel {
+    std::string text;
+    cv::Point origin;    // bottom left of the text, as for cv::putText
+    cv::Scalar color;
+    int height = 12;     // pixels
+    bool background = false;
+
+    bool operator==(const OverlayLabel &o) const {
+        return text == o.text && origin == o.origin && color == o.color &&
+               height == o.height && background == o.background;
+    }
+};
+
+struct Overlay {
+    std::vector<OverlayBox> boxes;
+    std::vector<OverlayLabel> labels;
+
+    // Signal plot
+    cv::Rect signalArea;
+    std::vector<cv::Point2f> signal;
+    cv::Scalar signalColor;
+
+    // Tracked corners, drawn as crosses
+    std::vector<cv::Point2f> corners;
+    cv::Scalar cornerColor;
+
+    // Bumped whenever any of the above changes
+    int version = 0;
+
+    void clear() {
+        boxes.clear();
+        labels.clear();
+        signalArea = cv::Rect();
+        signal.clear();
+        corners.clear();
+    }
+
+    bool sameContent(const Overlay &o) const {
+        return boxes == o.boxes && labels == o.labels && signalArea == o.signalArea &&
+               signal == o.signal && signalColor == o.signalColor &&
+               corners == o.corners && cornerColor == o.cornerColor;
+    }
+};
+
+#endif // OVERLAY_H
@@ -0,0 +1,143 @@
+#include "overlaylayer.h"
+#include <QBrush>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QPainterPath>
+#include <QPen>
+
+#define CROSS_SIZE 5
+
+static QColor toColor(const cv::Scalar &c)
+{
+    return QColor((int)c[0], (int)c[1], (int)c[2]);
+}
+
+OverlayLayer::OverlayLayer(QGraphicsItem *parent)
+    : parent(parent)
+{
+    signal = new QGraphicsPathItem(parent);
+    corners = new QGraphicsPathItem(parent);
+    signal->setZValue(2);
+    corners->setZValue(2);
+}
+
+QGraphicsRectItem *OverlayLayer::boxItem(size_t i)
+{
+    while (boxes.size() <= i) {
+        QGraphicsRectItem *item = new QGraphicsRectItem(parent);
+        item->setZValue(1);
+        boxes.push_back(item);
+    }
+    return boxes[i];
+}
+
+QGraphicsSimpleTextItem *OverlayLayer::labelItem(size_t i)
+{
+    while (labels.size() <= i) {
+        QGraphicsSimpleTextItem *item = new QGraphicsSimpleTextItem(parent);
+        item->setZValue(4);
+        labels.push_back(item);
+    }
+    return labels[i];
+}
+
+QGraphicsRectItem *OverlayLayer::labelBackground(size_t i)
+{
+    while (labelBackgrounds.size() <= i) {
+        QGraphicsRectItem *item = new QGraphicsRectItem(parent);
+        item->setZValue(3);
+        item->setPen(Qt::NoPen);
+        item->setBrush(Qt::black);
+        labelBackgrounds.push_back(item);
+    }
+    return labelBackgrounds[i];
+}
+
+void OverlayLayer::update(const Overlay &overlay)
+{
+    if (overlay.version == version) {
+        return;
+    }
+    version = overlay.version;
+
+    // Boxes
+    for (size_t i = 0; i < overlay.boxes.size(); i++) {
+        const OverlayBox &b = overlay.boxes[i];
+        QGraphicsRectItem *item = boxItem(i);
+        item->setRect(b.rect.x, b.rect.y, b.rect.width, b.rect.height);
+        if (b.thickness < 0) {
+            item->setPen(Qt::NoPen);
+            item->setBrush(toColor(b.color));
+        } else {
+            item->setPen(QPen(toColor(b.color), b.thickness));
+            item->setBrush(Qt::NoBrush);
+        }
+        item->show();
+    }
+    for (size_t i = overlay.boxes.size(); i < boxes.size(); i++) {
+        boxes[i]->hide();
+    }
+
+    // Signal
+    QPainterPath signalPath;
+    if (!overlay.signal.empty()) {
+        signalPath.moveTo(overlay.signal[0].x, overlay.signal[0].y);
+        for (size_t i = 1; i < overlay.signal.size(); i++) {
+            signalPath.lineTo(overlay.signal[i].x, overlay.signal[i].y);
+        }
+    }
+    signal->setPen(QPen(toColor(overlay.signalColor), 2));
+    signal->setPath(signalPath);
+
+    // Corners
+    QPainterPath cornerPath;
+    for (const cv::Point2f &c : overlay.corners) {
+        cornerPath.moveTo(c.x - CROSS_SIZE, c.y);
+        cornerPath.lineTo(c.x + CROSS_SIZE, c.y);
+        cornerPath.moveTo(c.x, c.y - CROSS_SIZE);
+        cornerPath.lineTo(c.x, c.y + CROSS_SIZE);
+    }
+    corners->setPen(QPen(toColor(overlay.cornerColor), 2));
+    corners->setPath(cornerPath);
+
+    // Labels, anchored at their baseline like putText
+    for (size_t i = 0; i < overlay.labels.size(); i++) {
+        const OverlayLabel &l = overlay.labels[i];
+        QGraphicsSimpleTextItem *item = labelItem(i);
+        QFont font = item->font();
+        font.setPixelSize(l.height);
+        font.setBold(true);
+        item->setFont(font);
+        item->setText(QString::fromStdString(l.text));
+        item->setBrush(toColor(l.color));
+        QFontMetricsF metrics(font);
+        item->setPos(l.origin.x, l.origin.y - metrics.ascent());
+        item->show();
+
+        QGraphicsRectItem *background = labelBackground(i);
+        if (l.background && !l.text.empty()) {
+            background->setRect(item->mapRectToParent(item->boundingRect()).adjusted(-5, -5, 5, 5));
+            background->show();
+        } else {
+            background->hide();
+        }
+    }
+    for (size_t i = overlay.labels.size(); i < labels.size(); i++) {
+        labels[i]->hide();
+        labelBackgrounds[i]->hide();
+    }
+}
+
+void OverlayLayer::clear()
+{
+    if (version == -1) {
+        return;
+    }
+    version = -1;
+
+    for (QGraphicsRectItem *item : boxes) item->hide();
+    for (QGraphicsSimpleTextItem *item : labels) item->hide();
+    for (QGraphicsRectItem *item : labelBackgrounds) item->hide();
+    signal->setPath(QPainterPath());
+    corners->setPath(QPainterPath());
+}
@@ -0,0 +1,36 @@
+#ifndef OVERLAYLAYER_H
+#define OVERLAYLAYER_H
+
+#include <QGraphicsItem>
+#include <QGraphicsPathItem>
+#include <QGraphicsRectItem>
+#include <QGraphicsSimpleTextItem>
+#include <vector>
+#include "overlay.h"
+
+// Renders an Overlay as scene items stacked above the video item.
+// Items are created once and only touched when the overlay version changes.
+class OverlayLayer
+{
+public:
+    explicit OverlayLayer(QGraphicsItem *parent);
+
+    void update(const Overlay &overlay);
+    void clear();
+
+private:
+    QGraphicsRectItem *boxItem(size_t i);
+    QGraphicsSimpleTextItem *labelItem(size_t i);
+    QGraphicsRectItem *labelBackground(size_t i);
+
+    QGraphicsItem *parent;
+    int version = -1;
+
+    std::vector<QGraphicsRectItem *> boxes;
+    std::vector<QGraphicsSimpleTextItem *> labels;
+    std::vector<QGraphicsRectItem *> labelBackgrounds;
+    QGraphicsPathItem *signal;
+    QGraphicsPathItem *corners;
+};
+
+#endif // OVERLAYLAYER_H
@@ -0,0 +1,109 @@
+#include "presenter.h"
+#include "profiler.h"
+#include <QEvent>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QScreen>
+#include <opencv2/imgproc.hpp>
+
+void FrameItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
+{
+    if (!image->isNull()) {
+        painter->drawImage(QPointF(0, 0), *image);
+    }
+}
+
+Presenter::Presenter(QGraphicsView *view, QWidget *window)
+    : QObject(window)
+    , view(view)
+    , window(window)
+{
+    frameItem = new FrameItem(&buffer);
+    view->scene()->addItem(frameItem);
+    view->installEventFilter(this);
+
+    // Present at the display refresh rate
+    qreal rate = QGuiApplication::primaryScreen() ? QGuiApplication::primaryScreen()->refreshRate() : 60.0;
+    if (rate <= 0) {
+        rate = 60.0;
+    }
+    timer.setTimerType(Qt::PreciseTimer);
+    timer.setInterval(qMax(1, qRound(1000.0 / rate)));
+    connect(&timer, &QTimer::timeout, this, &Presenter::present);
+    timer.start();
+}
+
+void Presenter::submit(const QImage &frame, quint64 captured)
+{
+    if (pending) {
+        superseded++;
+        Profiler::instance().countDrop(Drop::Superseded);
+    }
+    latest = frame;
+    latestCaptured = captured;
+    pending = true;
+}
+
+bool Presenter::isVisible() const
+{
+#if defined(Q_OS_IOS) || defined(Q_OS_ANDROID)
+    // On mobile an inactive application is in the background
+    if (QGuiApplication::applicationState() != Qt::ApplicationActive) {
+        return false;
+    }
+#endif
+    return window->isVisible() && !window->isMinimized();
+}
+
+void Presenter::present()
+{
+    if (!pending) {
+        return;
+    }
+    pending = false;
+
+    if (!isVisible()) {
+        skipped++;
+        Profiler::instance().countDrop(Drop::Hidden);
+        latest = QImage();
+        return;
+    }
+
+    PROFILE_STAGE(Stage::Present);
+
+    if (latest.format() != QImage::Format_RGB888) {
+        latest = latest.convertToFormat(QImage::Format_RGB888);
+    }
+
+    // Persistent buffer, reallocated only when the frame size changes
+    bool resized = buffer.size() != latest.size();
+    if (resized) {
+        // The scene has to see the old bounding rect before the buffer changes
+        frameItem->aboutToResize();
+        buffer = QImage(latest.size(), QImage::Format_RGB32);
+    }
+
+    // Convert straight into the buffer; RGB32 is the native format for painting
+    cv::Mat src(latest.height(), latest.width(), CV_8UC3, (void *)latest.constBits(), latest.bytesPerLine());
+    cv::Mat dst(buffer.height(), buffer.width(), CV_8UC4, buffer.bits(), buffer.bytesPerLine());
+    cv::cvtColor(src, dst, cv::COLOR_RGB2BGRA);
+    latest = QImage();
+
+    frameItem->update();
+    presented++;
+    // The scene repaints on the next paint event, which this does not include
+    Profiler::instance().record(Latency::CaptureToDisplay, ScopedStageTimer::now() - latestCaptured);
+
+    if (resized) {
+        view->fitInView(frameItem, Qt::KeepAspectRatio);
+    }
+}
+
+bool Presenter::eventFilter(QObject *watched, QEvent *event)
+{
+    // Refit only when the view changes size, not on every frame
+    if (watched == view && event->type() == QEvent::Resize && !buffer.isNull()) {
+        view->fitInView(frameItem, Qt::KeepAspectRatio);
+    }
+    return QObject::eventFilter(watched, event);
+}
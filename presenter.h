@@ -0,0 +1,67 @@
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include <QGraphicsItem>
+#include <QGraphicsView>
+#include <QImage>
+#include <QObject>
+#include <QTimer>
+
+// Scene item painting the presenter's persistent buffer directly, without a QPixmap
+class FrameItem : public QGraphicsItem
+{
+public:
+    explicit FrameItem(const QImage *image) : image(image) {}
+
+    QRectF boundingRect() const override { return QRectF(QPointF(0, 0), image->size()); }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *) override;
+    // Call before the image changes size
+    void aboutToResize() { prepareGeometryChange(); }
+
+private:
+    const QImage *image;
+};
+
+// Shows only the latest processed frame, at most once per display refresh
+class Presenter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Presenter(QGraphicsView *view, QWidget *window);
+
+    // Takes a shared reference; the frame is not copied until it is presented.
+    // captured is the frame's arrival time, for the capture-to-display latency.
+    void submit(const QImage &frame, quint64 captured);
+
+    QGraphicsItem *item() { return frameItem; }
+
+    quint64 presentedCount() const { return presented; }
+    quint64 supersededCount() const { return superseded; }
+    quint64 skippedCount() const { return skipped; }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void present();
+
+private:
+    bool isVisible() const;
+
+    QGraphicsView *view;
+    QWidget *window;
+    FrameItem *frameItem;
+    QTimer timer;
+
+    QImage latest;
+    quint64 latestCaptured = 0;
+    bool pending = false;
+    QImage buffer;
+
+    quint64 presented = 0;
+    quint64 superseded = 0;
+    quint64 skipped = 0;
+};
+
+#endif // PRESENTER_H
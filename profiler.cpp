@@ -0,0 +1,190 @@
+#include "profiler.h"
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const char *STAGE_NAMES[] = {
+    "ingest", "equalize", "detect", "track", "mask",
+    "mean", "buffer", "extract", "estimate", "draw", "present"
+};
+
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == (int)Stage::Count, "Stage names out of date");
+
+const char *stageName(Stage stage) {
+    return STAGE_NAMES[(int)stage];
+}
+
+static const char *LATENCY_NAMES[] = {"to-result", "to-display"};
+
+static_assert(sizeof(LATENCY_NAMES) / sizeof(LATENCY_NAMES[0]) == (int)Latency::Count, "Latency names out of date");
+
+const char *latencyName(Latency latency) {
+    return LATENCY_NAMES[(int)latency];
+}
+
+static const char *DROP_NAMES[] = {"stopped", "invalid", "queue", "superseded", "hidden"};
+
+static_assert(sizeof(DROP_NAMES) / sizeof(DROP_NAMES[0]) == (int)Drop::Count, "Drop names out of date");
+
+const char *dropName(Drop drop) {
+    return DROP_NAMES[(int)drop];
+}
+
+static const char *COUNTER_NAMES[] = {"frames", "rescans", "tracking_failures", "beats"};
+
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == (int)Counter::Count, "Counter names out of date");
+
+const char *counterName(Counter counter) {
+    return COUNTER_NAMES[(int)counter];
+}
+
+static const char *GAUGE_NAMES[] = {"fps", "bpm", "confidence", "quality_db", "time_to_first_bpm_seconds",
+                                    "hrv_rmssd_seconds", "hrv_sdnn_seconds"};
+
+static_assert(sizeof(GAUGE_NAMES) / sizeof(GAUGE_NAMES[0]) == (int)Gauge::Count, "Gauge names out of date");
+
+const char *gaugeName(Gauge gauge) {
+    return GAUGE_NAMES[(int)gauge];
+}
+
+static int highestBit(uint64_t v) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return (int)ns;
+    }
+    int exponent = highestBit(ns);
+    if (exponent > MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    int sub = (int)((ns >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+// Middle of the bucket in nanoseconds
+double LatencyHistogram::bucketValue(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BITS - 1;
+    int sub = index % SUB_BUCKETS;
+    double width = (double)(1ULL << (exponent - SUB_BITS));
+    return (SUB_BUCKETS + sub) * width + width / 2;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t previous = max.load(std::memory_order_relaxed);
+    while (ns > previous && !max.compare_exchange_weak(previous, ns, std::memory_order_relaxed)) {
+    }
+}
+
+StageStats LatencyHistogram::snapshot() const {
+
+    // Buckets are read one by one while other threads record, so totals can be off by
+    // the handful of samples recorded during the read
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    StageStats stats;
+    stats.count = total;
+    if (total == 0) {
+        return stats;
+    }
+    stats.mean = sum.load(std::memory_order_relaxed) / 1000.0 / total;
+    stats.max = max.load(std::memory_order_relaxed) / 1000.0;
+
+    const double quantiles[] = {0.50, 0.95, 0.99};
+    double *results[] = {&stats.p50, &stats.p95, &stats.p99};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < BUCKETS && q < 3; i++) {
+        seen += counts[i];
+        while (q < 3 && seen >= quantiles[q] * total) {
+            *results[q] = bucketValue(i) / 1000.0;
+            q++;
+        }
+    }
+    return stats;
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::reset() {
+    for (LatencyHistogram &histogram : histograms) {
+        histogram.reset();
+    }
+    for (LatencyHistogram &histogram : latencies) {
+        histogram.reset();
+    }
+    for (std::atomic<uint64_t> &drop : drops) {
+        drop.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t> &counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<double> &gauge : gauges) {
+        gauge.store(0.0, std::memory_order_relaxed);
+    }
+}
+
+static void appendStats(std::string &text, const char *name, const StageStats &s) {
+    if (s.count == 0) {
+        return;
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "%-10s %7.2f %7.2f %7.2f %7.2f %7llu\n", name,
+             s.p50 / 1000, s.p95 / 1000, s.p99 / 1000, s.max / 1000, (unsigned long long)s.count);
+    text += line;
+}
+
+std::string Profiler::report() const {
+    std::string text;
+    char line[128];
+    snprintf(line, sizeof(line), "%-10s %7s %7s %7s %7s %7s\n", "ms", "p50", "p95", "p99", "max", "n");
+    text += line;
+    for (int i = 0; i < (int)Stage::Count; i++) {
+        appendStats(text, STAGE_NAMES[i], histograms[i].snapshot());
+    }
+    for (int i = 0; i < (int)Latency::Count; i++) {
+        appendStats(text, LATENCY_NAMES[i], latencies[i].snapshot());
+    }
+    text += "dropped";
+    for (int i = 0; i < (int)Drop::Count; i++) {
+        snprintf(line, sizeof(line), " %s %llu", DROP_NAMES[i],
+                 (unsigned long long)drops[i].load(std::memory_order_relaxed));
+        text += line;
+    }
+    text += "\n";
+    return text;
+}
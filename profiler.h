@@ -0,0 +1,189 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "trace.h"
+
+// Latency histograms and drop counters for the frame pipeline.
+// End-to-end latencies and drops are recorded in every build. The per-stage timers need
+// CONFIG+=profiling; otherwise PROFILE_STAGE compiles to nothing.
+
+// Detect and Track include the Mask update they trigger
+enum class Stage {
+    Ingest,     // video frame to RGB Mat
+    Equalize,   // grey conversion and histogram equalisation
+    Detect,
+    Track,
+    Mask,
+    Mean,       // ROI colour means
+    Buffer,     // append to the signal buffers, drop the oldest samples
+    Extract,    // denoise, detrend and filter
+    Estimate,   // heart rate spectrum and peak
+    Draw,       // overlay scene items
+    Present,    // frame to screen buffer
+    Count
+};
+
+const char *stageName(Stage stage);
+
+// Age of a frame, measured from its arrival at the video sink
+enum class Latency {
+    CaptureToResult,    // BPM and overlay updated
+    CaptureToDisplay,   // frame handed to the scene
+    Count
+};
+
+const char *latencyName(Latency latency);
+
+// Places where a captured frame is thrown away before it is shown
+enum class Drop {
+    Stopped,    // arrived while capture is paused
+    Invalid,    // not a valid video frame
+    Queue,      // replaced in the sink before processing picked it up
+    Superseded, // replaced in the presenter before the next refresh
+    Hidden,     // window not visible at the refresh
+    Count
+};
+
+const char *dropName(Drop drop);
+
+// Pipeline events, counted in every build
+enum class Counter {
+    Frames,             // frames processed
+    Rescans,            // periodic face detection while tracking
+    TrackingFailures,   // face lost by the tracker
+    Beats,              // beats reported by RPPG
+    Count
+};
+
+const char *counterName(Counter counter);
+
+// Latest pipeline outputs
+enum class Gauge {
+    Fps,                // signal sampling rate
+    Bpm,
+    Confidence,         // progressive estimate, 1 once the full window is used
+    Quality,            // dB
+    TimeToFirstBpm,     // seconds
+    Rmssd,              // seconds, beat-to-beat variability
+    Sdnn,               // seconds
+    Count
+};
+
+const char *gaugeName(Gauge gauge);
+
+// Latencies in microseconds
+struct StageStats {
+    uint64_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Log-linear histogram of nanosecond durations, 16 buckets per power of two (about 6 % resolution).
+// Recording is a few relaxed atomic increments, so any thread can record without locking.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t ns);
+    StageStats snapshot() const;
+    void reset();
+
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int MAX_EXPONENT = 40; // about 18 minutes
+    static constexpr int BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS;
+
+    static int bucketIndex(uint64_t ns);
+    static double bucketValue(int index);
+
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+class Profiler
+{
+public:
+    static Profiler &instance();
+
+    void record(Stage stage, uint64_t ns) { histograms[(int)stage].record(ns); }
+    StageStats stats(Stage stage) const { return histograms[(int)stage].snapshot(); }
+
+    void record(Latency latency, uint64_t ns) { latencies[(int)latency].record(ns); }
+    StageStats stats(Latency latency) const { return latencies[(int)latency].snapshot(); }
+
+    void countDrop(Drop drop) { drops[(int)drop].fetch_add(1, std::memory_order_relaxed); }
+    uint64_t dropCount(Drop drop) const { return drops[(int)drop].load(std::memory_order_relaxed); }
+
+    void count(Counter counter) { counters[(int)counter].fetch_add(1, std::memory_order_relaxed); }
+    uint64_t value(Counter counter) const { return counters[(int)counter].load(std::memory_order_relaxed); }
+
+    void set(Gauge gauge, double v) { gauges[(int)gauge].store(v, std::memory_order_relaxed); }
+    double value(Gauge gauge) const { return gauges[(int)gauge].load(std::memory_order_relaxed); }
+
+    void reset();
+
+    // One line per stage and latency that has samples, in milliseconds, then the drop counts
+    std::string report() const;
+
+private:
+    Profiler() = default;
+
+    LatencyHistogram histograms[(int)Stage::Count];
+    LatencyHistogram latencies[(int)Latency::Count];
+    std::atomic<uint64_t> drops[(int)Drop::Count] = {};
+    std::atomic<uint64_t> counters[(int)Counter::Count] = {};
+    std::atomic<double> gauges[(int)Gauge::Count] = {};
+};
+
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(Stage stage) : stage(stage), previous(active), start(now()) { active = stage; }
+    ~ScopedStageTimer() {
+        active = previous;
+        uint64_t end = now();
+        Profiler::instance().record(stage, end - start);
+        if (Trace::enabled()) {
+            Trace::record(stageName(stage), start, end);
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer &) = delete;
+    ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+
+    // Innermost stage being timed on the calling thread, Stage::Count outside any
+    static Stage current() { return active; }
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    Stage stage;
+    Stage previous;
+    uint64_t start;
+
+    static inline thread_local Stage active = Stage::Count;
+};
+
+#ifdef HEARTBEAT_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Times the rest of the enclosing scope as stage
+#define PROFILE_STAGE(stage) ScopedStageTimer PROFILE_CONCAT(stageTimer, __LINE__)(stage)
+#else
+#define PROFILE_STAGE(stage)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,85 @@
+#include "roireplay.h"
+
+bool RoiReplay::open(const QString &path) {
+
+    file.close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // Stays mapped until the file is closed; blocks are decoded from it as they are reached
+    data = (const char *)file.map(0, file.size());
+    size = data ? (size_t)file.size() : 0;
+    return data && reader.open(data, size);
+}
+
+bool RoiReplay::refill(int dropped) {
+
+    means.erase(means.begin(), means.begin() + 3 * dropped);
+    times.erase(times.begin(), times.begin() + dropped);
+    rescans.erase(rescans.begin(), rescans.begin() + dropped);
+    resets.erase(resets.begin(), resets.begin() + dropped);
+    motions.erase(motions.begin(), motions.begin() + dropped);
+
+    RoiSample sample;
+    int decoded = 0;
+    while (decoded < ROI_REPLAY_CHUNK && reader.next(sample)) {
+        means.insert(means.end(), sample.means, sample.means + 3);
+        times.push_back(sample.time);
+        rescans.push_back(sample.rescan);
+        resets.push_back(sample.reset);
+        motions.push_back(sample.motion);
+        decoded++;
+    }
+    return decoded > 0;
+}
+
+void RoiReplay::run(RPPG &rppg, int intervalMs, const std::function<void(int time)> &onSample) {
+
+    samples = 0;
+    if (!data || !reader.open(data, size)) {
+        return;
+    }
+    means.clear();
+    times.clear();
+    rescans.clear();
+    resets.clear();
+    motions.clear();
+
+    Mat1d s;
+    Mat1i t;
+    Mat1b re;
+    Mat1d mo;
+    int next = 0;
+    int lastEstimate = 0;
+
+    for (;;) {
+        if (next == (int)times.size()) {
+            // Rows before RPPG's window are not read again
+            int dropped = samples > 0 ? rppg.dropReplayRows() : 0;
+            if (!refill(dropped)) {
+                break;
+            }
+            next -= dropped;
+
+            // Views over the decoded rows, rebuilt because the arrays may have moved
+            const int n = (int)times.size();
+            s = Mat1d(n, 3, means.data());
+            t = Mat1i(n, 1, times.data());
+            re = Mat1b(n, 1, rescans.data());
+            mo = Mat1d(n, 1, motions.data());
+        }
+
+        const int i = next++;
+        bool reset = samples == 0 || resets[i];
+        bool estimate = reset || intervalMs <= 0 || times[i] - lastEstimate >= intervalMs;
+        if (estimate) {
+            lastEstimate = times[i];
+        }
+        rppg.replaySample(s, t, re, mo, i, reset, estimate);
+        samples++;
+        if (onSample) {
+            onSample(times[i]);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef ROIREPLAY_H
+#define ROIREPLAY_H
+
+#include <functional>
+#include <vector>
+#include <QFile>
+#include <QString>
+#include "RPPG.hpp"
+#include "roitrace.h"
+
+#define ROI_REPLAY_CHUNK 4096 // samples decoded at a time
+
+// Runs a recorded ROI trace through RPPG's estimator, skipping capture and all vision stages.
+// The trace file is memory-mapped and decoded a chunk at a time while it is replayed. RPPG
+// reads the signal buffers through views of the decoded rows, and rows that have left its
+// window are dropped before the next chunk. Memory stays at one window and one chunk for
+// any length of trace, and the time goes into estimation.
+class RoiReplay
+{
+public:
+    // Maps path and checks its header, false if it is not a readable trace
+    bool open(const QString &path);
+
+    // Samples replayed by the last run
+    long long sampleCount() const { return samples; }
+    int64_t startTime() const { return reader.startTime(); }
+
+    // Feeds every sample to rppg, from the start of the trace on every call, and estimates
+    // at most once per intervalMs of trace time; 0 estimates on every sample like live
+    // processing. onSample runs after each sample with its time in ms. A damaged block ends
+    // the trace, the samples before it are replayed.
+    void run(RPPG &rppg, int intervalMs, const std::function<void(int time)> &onSample);
+
+private:
+    // Drops the first rows and appends up to ROI_REPLAY_CHUNK decoded samples, false at the end
+    bool refill(int dropped);
+
+    QFile file;
+    const char *data = nullptr;
+    size_t size = 0;
+    RoiTraceReader reader;
+
+    // Decoded rows, from the start of RPPG's window to the end of the current chunk
+    std::vector<double> means;
+    std::vector<int> times;
+    std::vector<uchar> rescans;
+    std::vector<uchar> resets;
+    std::vector<double> motions;
+    long long samples = 0;
+};
+
+#endif // ROIREPLAY_H
@@ -0,0 +1,320 @@
+#include "roitrace.h"
+#include <cmath>
+#include <cstring>
+#include <QDateTime>
+
+#define ROI_TRACE_MAGIC "HBRT"
+#define ROI_TRACE_VERSION 3 // 2 added FLAG_RESET, 3 split the fields into streams and FLAG_BOX into two
+#define ROI_TRACE_HEADER_SIZE 13
+#define ROI_TRACE_BLOCK_BYTES 65536
+#define MAX_RECORD_BYTES 128
+#define MAX_STREAM_HEADER_BYTES 32
+#define FILE_BUFFER_SIZE 65536
+
+#define FLAG_RESCAN 1
+#define FLAG_MOTION 2
+#define FLAG_BOX 4 // box position changed
+#define FLAG_RESET 8
+#define FLAG_SIZE 16 // box size changed
+#define FLAG_BITS 5
+
+#define STREAM_HEAD 0
+#define STREAM_MEANS 1 // one stream per channel
+#define STREAM_MOTION 4
+#define STREAM_BOX 5
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void putVarint(std::vector<char> &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static bool getVarint(const char *&p, const char *end, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = (uint8_t)*p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void putLittleEndian(char *out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (char)(v >> (8 * i));
+    }
+}
+
+static uint64_t getLittleEndian(const char *in, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+        v |= (uint64_t)(uint8_t)in[i] << (8 * i);
+    }
+    return v;
+}
+
+RoiTraceWriter::~RoiTraceWriter() {
+    close();
+}
+
+bool RoiTraceWriter::open(const std::string &path) {
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+    char header[ROI_TRACE_HEADER_SIZE];
+    memcpy(header, ROI_TRACE_MAGIC, 4);
+    header[4] = ROI_TRACE_VERSION;
+    putLittleEndian(header + 5, (uint64_t)QDateTime::currentMSecsSinceEpoch(), 8);
+    fwrite(header, 1, sizeof(header), file);
+
+    // Sized up front so encoding a frame does not allocate
+    for (std::vector<char> &stream : streams) {
+        stream.clear();
+        stream.reserve(ROI_TRACE_BLOCK_BYTES + MAX_RECORD_BYTES);
+    }
+    block.clear();
+    block.reserve(ROI_TRACE_BLOCK_BYTES + MAX_RECORD_BYTES + MAX_STREAM_HEADER_BYTES);
+    pending.reserve(4);
+    spare.reserve(4);
+    closing = false;
+    writer = std::thread(&RoiTraceWriter::run, this);
+    return true;
+}
+
+void RoiTraceWriter::append(const RoiSample &sample) {
+    if (!file) {
+        return;
+    }
+    size_t blockBytes = 0;
+    for (const std::vector<char> &stream : streams) {
+        blockBytes += stream.size();
+    }
+    if (blockBytes > 0 && (blockBytes >= ROI_TRACE_BLOCK_BYTES || sample.time - blockStart >= ROI_TRACE_BLOCK_MS)) {
+        flush();
+    }
+    if (streams[STREAM_HEAD].empty()) {
+        blockStart = sample.time;
+        state = RoiTraceState();
+    }
+
+    int step = sample.time - state.time;
+    int64_t motion = llround(sample.motion * ROI_TRACE_MOTION_SCALE);
+    bool moved = sample.box.tl() != state.box.tl();
+    bool resized = sample.box.size() != state.box.size();
+    uint64_t flags = (sample.rescan ? FLAG_RESCAN : 0) | (motion != 0 ? FLAG_MOTION : 0) |
+                     (moved ? FLAG_BOX : 0) | (sample.reset ? FLAG_RESET : 0) | (resized ? FLAG_SIZE : 0);
+
+    // Steady frame rates give a zero step change, so time and flags usually fit one byte
+    putVarint(streams[STREAM_HEAD], zigzag(step - state.step) << FLAG_BITS | flags);
+    state.time = sample.time;
+    state.step = step;
+
+    // The previous sample predicts each mean, only the change is stored
+    for (int c = 0; c < 3; c++) {
+        int64_t mean = llround(sample.means[c] * ROI_TRACE_MEAN_SCALE);
+        putVarint(streams[STREAM_MEANS + c], zigzag(mean - state.means[c]));
+        state.means[c] = mean;
+    }
+    if (motion != 0) {
+        putVarint(streams[STREAM_MOTION], zigzag(motion));
+    }
+    if (moved) {
+        putVarint(streams[STREAM_BOX], zigzag(sample.box.x - state.box.x));
+        putVarint(streams[STREAM_BOX], zigzag(sample.box.y - state.box.y));
+    }
+    if (resized) {
+        putVarint(streams[STREAM_BOX], zigzag(sample.box.width - state.box.width));
+        putVarint(streams[STREAM_BOX], zigzag(sample.box.height - state.box.height));
+    }
+    state.box = sample.box;
+}
+
+// Joins the streams into a block, hands it to the writer thread and continues in a recycled buffer
+void RoiTraceWriter::flush() {
+    for (int i = 0; i + 1 < ROI_TRACE_STREAMS; i++) {
+        putVarint(block, streams[i].size());
+    }
+    for (std::vector<char> &stream : streams) {
+        block.insert(block.end(), stream.begin(), stream.end());
+        stream.clear();
+    }
+
+    std::vector<char> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(block));
+        if (!spare.empty()) {
+            next = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    wake.notify_one();
+    block = std::move(next);
+    block.reserve(ROI_TRACE_BLOCK_BYTES + MAX_RECORD_BYTES + MAX_STREAM_HEADER_BYTES);
+}
+
+void RoiTraceWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this]() { return !pending.empty() || closing; });
+        if (pending.empty()) {
+            break;
+        }
+        std::vector<char> raw = std::move(pending.front());
+        pending.erase(pending.begin());
+        lock.unlock();
+
+        QByteArray packed = qCompress((const uchar *)raw.data(), (int)raw.size());
+        char length[4];
+        putLittleEndian(length, (uint64_t)packed.size(), 4);
+        fwrite(length, 1, sizeof(length), file);
+        fwrite(packed.constData(), 1, packed.size(), file);
+        // Each block reaches the file as it is done, so a crash loses at most the open one
+        fflush(file);
+        raw.clear();
+
+        lock.lock();
+        spare.push_back(std::move(raw));
+    }
+}
+
+void RoiTraceWriter::close() {
+    if (!file) {
+        return;
+    }
+    if (!streams[STREAM_HEAD].empty()) {
+        flush();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    wake.notify_one();
+    writer.join();
+    fclose(file);
+    file = nullptr;
+}
+
+bool RoiTraceReader::open(const char *data, size_t size) {
+    this->data = data;
+    this->size = size;
+    offset = 0;
+    block.clear();
+    for (int i = 0; i < ROI_TRACE_STREAMS; i++) {
+        cursor[i] = streamEnd[i] = nullptr;
+    }
+    // Records of other versions do not decode with this layout, so they are rejected
+    if (size < ROI_TRACE_HEADER_SIZE || memcmp(data, ROI_TRACE_MAGIC, 4) || data[4] != ROI_TRACE_VERSION) {
+        return false;
+    }
+    start = (int64_t)getLittleEndian(data + 5, 8);
+    offset = ROI_TRACE_HEADER_SIZE;
+    return true;
+}
+
+bool RoiTraceReader::nextBlock() {
+    if (offset + 4 > size) {
+        return false;
+    }
+    size_t length = (size_t)getLittleEndian(data + offset, 4);
+    if (offset + 4 + length > size) {
+        return false;
+    }
+    block = qUncompress((const uchar *)data + offset + 4, (int)length);
+    offset += 4 + length;
+    state = RoiTraceState();
+
+    // Stream lengths, the last stream takes the rest of the block
+    const char *p = block.constData();
+    const char *end = p + block.size();
+    uint64_t lengths[ROI_TRACE_STREAMS - 1];
+    for (uint64_t &streamLength : lengths) {
+        if (!getVarint(p, end, streamLength)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < ROI_TRACE_STREAMS; i++) {
+        uint64_t streamLength = i + 1 < ROI_TRACE_STREAMS ? lengths[i] : (uint64_t)(end - p);
+        if (streamLength > (uint64_t)(end - p)) {
+            return false;
+        }
+        cursor[i] = p;
+        streamEnd[i] = p + streamLength;
+        p += streamLength;
+    }
+    return cursor[STREAM_HEAD] < streamEnd[STREAM_HEAD];
+}
+
+bool RoiTraceReader::next(RoiSample &sample) {
+    while (cursor[STREAM_HEAD] >= streamEnd[STREAM_HEAD]) {
+        if (!nextBlock()) {
+            return false;
+        }
+    }
+
+    uint64_t v;
+    if (!getVarint(cursor[STREAM_HEAD], streamEnd[STREAM_HEAD], v)) {
+        return false;
+    }
+    int flags = (int)(v & ((1 << FLAG_BITS) - 1));
+    state.step += (int)unzigzag(v >> FLAG_BITS);
+    state.time += state.step;
+    sample.time = state.time;
+    sample.rescan = flags & FLAG_RESCAN;
+    sample.reset = flags & FLAG_RESET;
+
+    for (int c = 0; c < 3; c++) {
+        if (!getVarint(cursor[STREAM_MEANS + c], streamEnd[STREAM_MEANS + c], v)) {
+            return false;
+        }
+        state.means[c] += unzigzag(v);
+        sample.means[c] = (double)state.means[c] / ROI_TRACE_MEAN_SCALE;
+    }
+
+    sample.motion = 0.0;
+    if (flags & FLAG_MOTION) {
+        if (!getVarint(cursor[STREAM_MOTION], streamEnd[STREAM_MOTION], v)) {
+            return false;
+        }
+        sample.motion = (double)unzigzag(v) / ROI_TRACE_MOTION_SCALE;
+    }
+
+    // Position, then size, each only when flagged
+    for (int part = 0; part < 2; part++) {
+        if (!(flags & (part == 0 ? FLAG_BOX : FLAG_SIZE))) {
+            continue;
+        }
+        int64_t delta[2];
+        for (int i = 0; i < 2; i++) {
+            if (!getVarint(cursor[STREAM_BOX], streamEnd[STREAM_BOX], v)) {
+                return false;
+            }
+            delta[i] = unzigzag(v);
+        }
+        if (part == 0) {
+            state.box.x += (int)delta[0];
+            state.box.y += (int)delta[1];
+        } else {
+            state.box.width += (int)delta[0];
+            state.box.height += (int)delta[1];
+        }
+    }
+    sample.box = state.box;
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef ROITRACE_H
+#define ROITRACE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <QByteArray>
+#include <opencv2/core.hpp>
+
+// Compact recording of what RPPG::processFrame adds to its signal buffers, so a session
+// can be reanalysed without its video.
+//
+// The recording is lossy: ROI means are rounded to 1/ROI_TRACE_MEAN_SCALE of a colour
+// level (error at most 1/32 level, below the camera noise in a face ROI mean) and motion to
+// 1/ROI_TRACE_MOTION_SCALE (error at most 0.0005, well inside the motion thresholds). Replay
+// therefore matches the live signal to that precision, not bit for bit. Timestamps, flags
+// and boxes are exact.
+//
+// File layout: "HBRT", a version byte and the wall clock start time in ms (8 bytes, little
+// endian), then blocks of a 4 byte little endian length and qCompress'ed records. A block
+// holds about ROI_TRACE_BLOCK_MS of frames, decodes on its own and is flushed once written,
+// so a cut-off file loses at most the block that was still being recorded.
+//
+// Inside a block each field is kept in its own stream, so deflate sees runs of similar
+// bytes: the byte lengths of all but the last stream, then the streams. The head stream
+// holds a varint per record of the time step change and flags. Each mean stream holds the
+// change from the previous sample in 1/ROI_TRACE_MEAN_SCALE colour levels. The motion and
+// box streams only get values for records whose flags say they are present, the box as
+// position and size changes. Deltas are zigzag encoded.
+
+#define ROI_TRACE_MEAN_SCALE 16
+#define ROI_TRACE_MOTION_SCALE 1000
+#define ROI_TRACE_BLOCK_MS 10000
+#define ROI_TRACE_STREAMS 6 // head, three means, motion, box
+
+struct RoiSample {
+    int time = 0;               // ms, as pushed into t
+    double means[3] = {0, 0, 0}; // ROI colour means, as pushed into s (quantised in files)
+    bool rescan = false;
+    bool reset = false;         // first sample after the signal buffers were cleared
+    double motion = 0.0;
+    cv::Rect box;
+};
+
+// Delta state shared by the encoder and the decoder, reset at every block
+struct RoiTraceState {
+    int time = 0;
+    int step = 0;
+    int64_t means[3] = {0, 0, 0};
+    cv::Rect box;
+};
+
+// Encodes on the calling thread into a block buffer; full blocks are compressed and
+// written by a background thread.
+class RoiTraceWriter
+{
+public:
+    RoiTraceWriter() = default;
+    ~RoiTraceWriter();
+
+    bool open(const std::string &path);
+    void append(const RoiSample &sample);
+    // Writes the pending records and closes the file
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+
+private:
+    void flush();
+    void run();
+
+    FILE *file = nullptr;
+    std::thread writer;
+
+    // Frame thread
+    std::vector<char> streams[ROI_TRACE_STREAMS];
+    std::vector<char> block;
+    RoiTraceState state;
+    int blockStart = 0;
+
+    // Shared with the writer thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::vector<char>> pending;
+    std::vector<std::vector<char>> spare;
+    bool closing = false;
+};
+
+// Decodes a trace held in memory, e.g. a mapped file
+class RoiTraceReader
+{
+public:
+    bool open(const char *data, size_t size);
+    // False at the end of the trace or at a damaged block
+    bool next(RoiSample &sample);
+
+    int64_t startTime() const { return start; }
+
+private:
+    bool nextBlock();
+
+    const char *data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    int64_t start = 0;
+
+    QByteArray block;
+    const char *cursor[ROI_TRACE_STREAMS] = {};
+    const char *streamEnd[ROI_TRACE_STREAMS] = {};
+    RoiTraceState state;
+};
+
+#endif // ROITRACE_H
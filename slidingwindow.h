@@ -0,0 +1,119 @@
+#ifndef SLIDINGWINDOW_H
+#define SLIDINGWINDOW_H
+
+#include <cstdint>
+
+// Fixed capacity ring buffer; pushing into a full buffer drops the oldest element
+template<typename T, int N>
+class RingBuffer
+{
+public:
+    void clear() { head = 0; count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    static constexpr int capacity() { return N; }
+
+    void push_back(const T &value) {
+        if (count == N) {
+            data[head] = value;
+            head = (head + 1) % N;
+        } else {
+            data[(head + count) % N] = value;
+            count++;
+        }
+    }
+
+    void pop_front() {
+        head = (head + 1) % N;
+        count--;
+    }
+
+    void pop_back() { count--; }
+
+    // 0 is the oldest element
+    T &operator[](int i) { return data[(head + i) % N]; }
+    const T &operator[](int i) const { return data[(head + i) % N]; }
+    T &front() { return data[head]; }
+    const T &front() const { return data[head]; }
+    T &back() { return data[(head + count - 1) % N]; }
+    const T &back() const { return data[(head + count - 1) % N]; }
+
+private:
+    T data[N];
+    int head = 0;
+    int count = 0;
+};
+
+// Timestamped samples with O(1) amortised min, max and mean.
+// Min and max come from monotonic deques of sample sequence numbers.
+template<int N>
+class SlidingWindow
+{
+public:
+    void clear() {
+        times.clear();
+        values.clear();
+        minq.clear();
+        maxq.clear();
+        first = 0;
+        next = 0;
+        sum = 0.0;
+    }
+
+    void push(int64_t time, double value) {
+        if (values.full()) {
+            pop();
+        }
+        times.push_back(time);
+        values.push_back(value);
+        sum += value;
+
+        while (!maxq.empty() && at(maxq.back()) <= value) maxq.pop_back();
+        maxq.push_back(next);
+        while (!minq.empty() && at(minq.back()) >= value) minq.pop_back();
+        minq.push_back(next);
+        next++;
+    }
+
+    // Drop samples older than time
+    void evictBefore(int64_t time) {
+        while (!times.empty() && times.front() < time) {
+            pop();
+        }
+    }
+
+    int size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    double min() const { return at(minq.front()); }
+    double max() const { return at(maxq.front()); }
+    double mean() const { return values.empty() ? 0.0 : sum / values.size(); }
+
+    // 0 is the oldest sample
+    double value(int i) const { return values[i]; }
+    int64_t time(int i) const { return times[i]; }
+
+private:
+    double at(int64_t seq) const { return values[(int)(seq - first)]; }
+
+    void pop() {
+        sum -= values.front();
+        if (maxq.front() == first) maxq.pop_front();
+        if (minq.front() == first) minq.pop_front();
+        times.pop_front();
+        values.pop_front();
+        first++;
+        // Keep the running sum exact once the window drains
+        if (values.empty()) sum = 0.0;
+    }
+
+    RingBuffer<int64_t, N> times;
+    RingBuffer<double, N> values;
+    RingBuffer<int64_t, N> minq;
+    RingBuffer<int64_t, N> maxq;
+    int64_t first = 0; // sequence number of the oldest sample
+    int64_t next = 0;
+    double sum = 0.0;
+};
+
+#endif // SLIDINGWINDOW_H
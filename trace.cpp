@@ -0,0 +1,130 @@
+#include "trace.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#define TRACE_RING_SIZE 16384 // events kept per thread
+
+struct TraceEvent {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Written only by its own thread. head counts every event ever recorded.
+struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    std::atomic<uint64_t> head{0};
+    std::atomic<const char *> threadName{nullptr};
+    int id = 0;
+};
+
+// Rings are never freed so events of finished threads can still be dumped
+static std::mutex ringsMutex;
+static std::vector<TraceRing *> rings;
+static std::atomic<uint64_t> origin(0);
+
+std::atomic<bool> Trace::active(false);
+
+static TraceRing *threadRing() {
+    thread_local TraceRing *ring = nullptr;
+    if (!ring) {
+        ring = new TraceRing();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        ring->id = (int)rings.size() + 1;
+        rings.push_back(ring);
+    }
+    return ring;
+}
+
+void Trace::start() {
+    origin.store(ScopedStageTimer::now(), std::memory_order_relaxed);
+    active.store(true, std::memory_order_release);
+}
+
+void Trace::stop() {
+    active.store(false, std::memory_order_release);
+}
+
+void Trace::record(const char *name, uint64_t start, uint64_t end) {
+    TraceRing *ring = threadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent &event = ring->events[head % TRACE_RING_SIZE];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char *name) {
+    threadRing()->threadName.store(name, std::memory_order_release);
+}
+
+bool Trace::dump(const std::string &path) {
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<TraceRing *> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        snapshot = rings;
+    }
+
+    const uint64_t t0 = origin.load(std::memory_order_relaxed);
+    std::vector<TraceEvent> events;
+    bool first = true;
+
+    fprintf(file, "{\"traceEvents\": [\n");
+    for (TraceRing *ring : snapshot) {
+
+        const char *threadName = ring->threadName.load(std::memory_order_acquire);
+        if (threadName) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", ring->id, threadName);
+            first = false;
+        }
+
+        // Copy the retained events, then drop the slots the owner overwrote meanwhile.
+        // The owner fills slot head % SIZE before publishing head + 1, so with the head
+        // at after, slot after - SIZE may already be half rewritten.
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        events.clear();
+        for (uint64_t i = begin; i < head; i++) {
+            events.push_back(ring->events[i % TRACE_RING_SIZE]);
+        }
+        uint64_t after = ring->head.load(std::memory_order_acquire);
+        uint64_t valid = after >= TRACE_RING_SIZE ? after - TRACE_RING_SIZE + 1 : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < head; i++) {
+            const TraceEvent &event = events[i - begin];
+            if (event.start < t0) {
+                continue;
+            }
+            fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    first ? "" : ",\n", event.name, ring->id,
+                    (event.start - t0) / 1000.0, (event.end - event.start) / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(file, "\n],\n\"displayTimeUnit\": \"ms\"}\n");
+
+    return fclose(file) == 0;
+}
+
+ScopedTrace::ScopedTrace(const char *name)
+    : name(name)
+    , start(Trace::enabled() ? ScopedStageTimer::now() : 0)
+{
+}
+
+ScopedTrace::~ScopedTrace() {
+    if (start && Trace::enabled()) {
+        Trace::record(name, start, ScopedStageTimer::now());
+    }
+}
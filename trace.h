@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Event recorder for Chrome's trace-event format, viewable in Perfetto or chrome://tracing.
+// Part of the profiling build. Every thread writes complete events (name, start, duration) into
+// its own fixed ring, so recording takes no lock and memory stays bounded; once a ring is full
+// the oldest events are overwritten. Nested scopes show up as nested slices.
+
+class Trace
+{
+public:
+    // Recording is off until start is called
+    static void start();
+    static void stop();
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    // Times are ScopedStageTimer::now() nanoseconds; name must be a string literal
+    static void record(const char *name, uint64_t start, uint64_t end);
+
+    // Label for the calling thread's track
+    static void setThreadName(const char *name);
+
+    // Writes every thread's retained events as trace-event JSON
+    static bool dump(const std::string &path);
+
+private:
+    static std::atomic<bool> active;
+};
+
+class ScopedTrace
+{
+public:
+    explicit ScopedTrace(const char *name);
+    ~ScopedTrace();
+
+    ScopedTrace(const ScopedTrace &) = delete;
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+#ifdef HEARTBEAT_PROFILING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// Records the rest of the enclosing scope as one slice
+#define TRACE_SCOPE(name) ScopedTrace TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+#endif // TRACE_H